@@ -18,6 +18,23 @@
 #ifdef __linux__
  #define HAVE_UIO
  #include <glob.h>
+ #include <sys/socket.h>
+ #include <sys/un.h>
+#endif
+
+#if defined(HAVE_MMAP) && !defined(EPICS_3_13)
+ #define HAVE_FILEIO
+ #define HAVE_PERSIST
+ #include <epicsExit.h>
+ #if defined(__linux__) && defined(__has_include)
+  #if __has_include(<linux/io_uring.h>)
+   #define HAVE_URING
+   #include <stdint.h>
+   #include <sys/uio.h>
+   #include <sys/syscall.h>
+   #include <linux/io_uring.h>
+  #endif
+ #endif
 #endif
 
 #ifndef EPICS_3_13
@@ -27,6 +44,7 @@
  #include <epicsThread.h>
  #include <epicsEvent.h>
  #include <epicsMutex.h>
+ #include <epicsTime.h>
  #include <epicsFindSymbol.h>
  #include <epicsStdioRedirect.h>
  #include <epicsExport.h>
@@ -80,12 +98,93 @@ typedef unsigned long long epicsUInt64;
 #ifndef __GNUC__
 #define __attribute__(x)
 #define strcasecmp strcmp
+#define strncasecmp strncmp
+#endif
+
+#if defined(__GNUC__) && (__GNUC__ > 4 || (__GNUC__ == 4 && __GNUC_MINOR__ >= 7))
+ #define HAVE_ATOMIC
+#endif
+
+#if defined(HAVE_ATOMIC) && !defined(EPICS_3_13)
+ #define HAVE_WRITEBEHIND
+#endif
+
+#ifndef EPICS_3_13
+ #define HAVE_SHADOW
+ #define HAVE_MIRROR
+#endif
+
+#if defined(HAVE_ATOMIC) && defined(HAVE_MMAP) && !defined(EPICS_3_13)
+ #define HAVE_CAPTURE
+ #define HAVE_EXPORT
+ #include <time.h>
+ #include "mmapProducer.h"
+#endif
+
+#if defined(HAVE_ATOMIC) && !defined(EPICS_3_13)
+ #define HAVE_PARALLEL
+ #define HAVE_CHUNK
+ #define HAVE_PUBLISH
+ #include "mmapPublish.h"
+ #ifdef __linux__
+  #include <sched.h>
+ #endif
+#endif
+
+#if defined(__GNUC__) && (__GNUC__ > 4 || (__GNUC__ == 4 && __GNUC_MINOR__ >= 9)) && (defined(__x86_64__) || defined(__i386__))
+ #define HAVE_AVX2
+ #include <immintrin.h>
+#endif
+#if defined(__ARM_NEON) || defined(__ARM_NEON__)
+ #define HAVE_NEON
+ #include <arm_neon.h>
+#endif
+
+#ifdef __linux__
+ #include <sys/vfs.h>
+ #ifndef SYSFS_MAGIC
+ #define SYSFS_MAGIC 0x62656572
+ #endif
+#endif
+
+#if defined(__linux__) && !defined(EPICS_3_13)
+ #include <sys/syscall.h>
+ #ifdef SYS_memfd_create
+  #define HAVE_MEMFD
+  #ifndef MFD_CLOEXEC
+  #define MFD_CLOEXEC       0x0001U
+  #define MFD_ALLOW_SEALING 0x0002U
+  #endif
+  #ifndef F_ADD_SEALS
+  #define F_ADD_SEALS       1033
+  #define F_SEAL_SEAL       0x0001
+  #define F_SEAL_SHRINK     0x0002
+  #define F_SEAL_GROW       0x0004
+  #endif
+ #endif
+#endif
+
+#if defined(HAVE_ATOMIC) && defined(__unix) && !defined(EPICS_3_13)
+ #define HAVE_TRACE
+ #include <time.h>
+#endif
+
+#if defined(HAVE_ATOMIC) && EPICSVER >= 31500
+ #define HAVE_SNAPSHOT
+ #include <callback.h>
 #endif
 
 #define MAGIC 2661166104U /* crc("mmap") */
 
+#ifndef ASYNC_COMPLETION
+#define ASYNC_COMPLETION 1
+#endif
+
 #define INTR_NONE  0
 #define INTR_UIO  -2
+#define INTR_FD   -3
+#define INTR_REPLAY -4
+#define INTR_MIRROR -5
 
 struct regDevice {
     unsigned long magic;
@@ -106,21 +205,174 @@ struct regDevice {
     int maxDmaSpeed;
     epicsEventId dmaComplete;
 #endif /* HAVE_DMA */
+#ifdef HAVE_WRITEBEHIND
+    struct mmapWriteQueue* writeQueue;
+#endif /* HAVE_WRITEBEHIND */
+#ifdef HAVE_FILEIO
+    int fd;
+    epicsMutexId fileLock;
+#ifdef HAVE_URING
+    struct mmapUring* uring;
+#endif /* HAVE_URING */
+#endif /* HAVE_FILEIO */
+    struct mmapIntrStatus* intrstatus;
+    struct mmapIntrAck* intrack;    /* terminated by op 0 */
+    unsigned int shards;            /* split I/O Intr records into scan lists */
+    size_t shardSize;               /* by offset or 0 for round robin */
+#ifdef HAVE_SNAPSHOT
+    struct mmapSnapshot* snapshot;
+#endif /* HAVE_SNAPSHOT */
+#ifdef HAVE_PERSIST
+    char* persist;
+    double persistPeriod;
+    unsigned long long persistCount;
+#endif /* HAVE_PERSIST */
+#ifdef HAVE_SHADOW
+    struct mmapShadow* shadow;
+#endif /* HAVE_SHADOW */
+#ifdef HAVE_PARALLEL
+    size_t parallelSize;
+#endif /* HAVE_PARALLEL */
+#ifdef HAVE_CHUNK
+    size_t chunkSize;
+    int chunkPending[3];            /* transfers in progress per priority */
+    epicsEventId chunkDone;
+    unsigned long long chunkYields;
+    struct mmapChunkQueue* chunkQueue;
+#endif /* HAVE_CHUNK */
+#ifdef HAVE_MIRROR
+    struct mmapMirror* mirror;
+#endif /* HAVE_MIRROR */
+#ifdef HAVE_EXPORT
+    struct mmapExport* export;
+#endif /* HAVE_EXPORT */
+#ifdef HAVE_PUBLISH
+    struct mmapPublisher* publisher;
+#endif /* HAVE_PUBLISH */
+#ifdef HAVE_CAPTURE
+    struct mmapCapture* capture;
+    struct mmapReplayState* replay;
+#endif /* HAVE_CAPTURE */
+#ifdef HAVE_MEMFD
+    int memfd;
+    int memfdListen;
+    char* memfdSocket;
+    unsigned long long memfdClients;
+#endif /* HAVE_MEMFD */
+    struct mmapView* view;
+    size_t size;
+    regDevice* next;
 };
 
+static regDevice* mmapDevices = NULL;
+
 int mmapDebug = 0;
+int mmapTrace = 0;
 
 /* Device flags */
 #define ALLOW_DMA            0x0000001
 #define BLOCK_DEVICE         0x0000002
 #define MAP_DEVICE           0x0000004
+#define FILE_DEVICE          0x0000010
+#define MEMORY_DEVICE        0x0000020
+#define CACHED_DEVICE        0x0000040
+#define UNCACHED_DEVICE      0x0000008
 #define READONLY_DEVICE      0x0000080
 #define SWAP_BYTE_PAIRS      0x0000100
 #define SWAP_WORD_PAIRS      0x0000200
 #define SWAP_DWORD_PAIRS     0x0000400
+#define SHARED_DEVICE        0x0000800
+
+/* memory other processes may modify concurrently */
+#define SHARED_MEMORY(device) (((device)->flags & (MEMORY_DEVICE|SHARED_DEVICE)) == (MEMORY_DEVICE|SHARED_DEVICE))
 
 /******** Support functions *****************************/
 
+#ifdef HAVE_MMAP
+/* Cached mappings of memory written by DMA (e.g. reserved RAM in /dev/mem)
+   need explicit cache maintenance: invalidate before the CPU reads and
+   flush after the CPU writes.
+*/
+static void mmapCacheMaintenance(volatile char* start, size_t len, int invalidate)
+{
+#if defined(__aarch64__)
+    static size_t line = 0;
+    size_t addr, end = (size_t)start + len;
+
+    if (!line)
+    {
+        epicsUInt64 ctr;
+        __asm__ volatile ("mrs %0, ctr_el0" : "=r" (ctr));
+        line = 4 << ((ctr >> 16) & 0xf); /* smallest data cache line */
+    }
+    for (addr = (size_t)start & ~(line-1); addr < end; addr += line)
+    {
+        /* user space cannot invalidate without clean */
+        if (invalidate)
+            __asm__ volatile ("dc civac, %0" : : "r" (addr) : "memory");
+        else
+            __asm__ volatile ("dc cvac, %0" : : "r" (addr) : "memory");
+    }
+    __asm__ volatile ("dsb sy" : : : "memory");
+#elif defined(__x86_64__) || defined(__i386__)
+    /* DMA is cache coherent on x86, only order the accesses */
+    (void)start; (void)len; (void)invalidate;
+    __sync_synchronize();
+#else
+    size_t pagesize = sysconf(_SC_PAGE_SIZE);
+    char* page = (char*)((size_t)start & ~(pagesize-1));
+
+    if (msync(page, len + ((char*)start - page), invalidate ? MS_INVALIDATE : MS_SYNC) != 0 && mmapDebug)
+        printf("mmapCacheMaintenance: msync %p failed: %s\n", start, strerror(errno));
+#endif
+}
+
+#define CACHE_INVALIDATE(device, offset, len) \
+    do { if ((device)->flags & CACHED_DEVICE) \
+        mmapCacheMaintenance((device)->localbaseaddress+(offset), (len), 1); } while (0)
+#define CACHE_FLUSH(device, offset, len) \
+    do { if ((device)->flags & CACHED_DEVICE) \
+        mmapCacheMaintenance((device)->localbaseaddress+(offset), (len), 0); } while (0)
+#else /* !HAVE_MMAP */
+#define CACHE_INVALIDATE(device, offset, len)
+#define CACHE_FLUSH(device, offset, len)
+#endif /* !HAVE_MMAP */
+
+#define MAX_INTR_CAUSES 64
+#define MAX_INTR_SHARDS 64
+#define INTR_CAUSE_SHIFT 16
+
+typedef struct mmapIntrStatus {
+    size_t offset;
+    unsigned int width;             /* bytes */
+    int w1c;
+    unsigned int ncauses;
+    epicsUInt64 allmask;
+    epicsUInt64 masks[MAX_INTR_CAUSES];
+} mmapIntrStatus;
+
+#define MAX_INTR_ACKS 8
+#define ACK_SET     1
+#define ACK_CLEAR   2
+#define ACK_WRITE   3
+#define ACK_W1C     4
+#define ACK_READ    5
+
+typedef struct mmapIntrAck {
+    size_t offset;
+    unsigned int width;             /* bytes */
+    int op;
+    epicsUInt64 value;
+} mmapIntrAck;
+
+/* Scan lists of one sharded device at one interrupt source */
+typedef struct mmapShardSet {
+    struct mmapShardSet* next;
+    regDevice *device;
+    unsigned int nextshard;
+    IOSCANPVT shards[1];            /* device->shards */
+} mmapShardSet;
+
 typedef struct mmapIntrInfo {
     struct mmapIntrInfo* next;
     regDevice *device;
@@ -128,8 +380,12 @@ typedef struct mmapIntrInfo {
     int intrvector;
     int intrlevel;
     unsigned long long intrcount;
+    IOSCANPVT causes[MAX_INTR_CAUSES];
+    unsigned long long causecount[MAX_INTR_CAUSES];
+    mmapShardSet* shardsets;
 #ifdef HAVE_UIO
     unsigned long long intrmissed;
+    int fdtype;
     int uiofd;
     char uioname[1];
 #endif
@@ -137,244 +393,3685 @@ typedef struct mmapIntrInfo {
 static mmapIntrInfo* intrInfos = NULL;
 static epicsMutexId mmapConnectInterruptLock;
 
-void mmapInterrupt(void *arg)
+/* Interrupt status decode: The status register is read once per interrupt
+   and only the scan lists of the asserted causes are triggered.
+*/
+
+static epicsUInt64 mmapReadIntrStatus(regDevice *device)
 {
-    mmapIntrInfo *info = arg;
-    regDevice *device = info->device;
-    info->intrcount++;
-    if (mmapDebug >= 2)
-        printf("mmapInterrupt %s: vector %d %s count = %llu, %s\n",
-            device->name, device->intrvector,
-#ifdef HAVE_UIO
-            info->uioname,
-#else
-            "",
-#endif
-            info->intrcount,
-            device->intrhandler ? "calling handler" : "no handler installed");
-    if (device->intrhandler)
+    mmapIntrStatus* st = device->intrstatus;
+    volatile char* reg = device->localbaseaddress + st->offset;
+    epicsUInt64 status;
+
+    switch (st->width)
     {
-        if (device->intrhandler(device) != 0) return;
+        case 1: status = *(volatile epicsUInt8*)reg; break;
+        case 2: status = *(volatile epicsUInt16*)reg; break;
+        case 4: status = *(volatile epicsUInt32*)reg; break;
+        default: status = *(volatile epicsUInt64*)reg; break;
     }
-    scanIoRequest(info->ioscanpvt);
+    if (st->w1c && (status & st->allmask))
+    {
+        /* write 1 to clear the causes we handle */
+        switch (st->width)
+        {
+            case 1: *(volatile epicsUInt8*)reg = status & st->allmask; break;
+            case 2: *(volatile epicsUInt16*)reg = status & st->allmask; break;
+            case 4: *(volatile epicsUInt32*)reg = status & st->allmask; break;
+            default: *(volatile epicsUInt64*)reg = status & st->allmask; break;
+        }
+        SYNC
+    }
+    return status;
 }
 
-#ifdef HAVE_UIO
-
-void mmapUioInterruptThread(void* arg)
+static void mmapDemuxInterrupt(mmapIntrInfo *info, epicsUInt64 status)
 {
-    mmapIntrInfo *info = arg;
     regDevice *device = info->device;
-    int fd = info->uiofd;
-    int n;
-    epicsUInt32 intrno = 0;
-    epicsUInt32 reenable = 1;
-    epicsUInt32 lastnum = 0;
+    mmapIntrStatus* st = device->intrstatus;
+    unsigned int i;
 
-    if (write(fd, &reenable, 4) == -1)
+    for (i = 0; i < st->ncauses; i++)
     {
-        if (mmapDebug)
-            printf("mmapUioInterruptThread %s: %s does not need re-enable.\n",
-                device->name, info->uioname);
-        reenable = 0;
+        if (status & st->masks[i])
+        {
+            info->causecount[i]++;
+            if (info->causes[i])
+                scanIoRequest(info->causes[i]);
+        }
     }
-    while ((n=read(fd, &intrno, 4)) != -1)
-    {
-        if (mmapDebug >= 2)
-            printf("mmapUioInterruptThread %s: Interrupt number %u (%d bytes read).\n",
-                device->name, n, intrno);
+}
+
+/* spec: offset:bits[:w1c], causes: mask/mask/... (default: one cause per bit) */
+static int mmapConfigureIntrStatus(regDevice *device, const char* spec, const char* causes)
+{
+    mmapIntrStatus* st;
+    unsigned long bits;
+    char* end;
 
-        if (lastnum && intrno != lastnum+1)
+    st = calloc(1, sizeof(mmapIntrStatus));
+    if (!st)
+    {
+        errlogSevPrintf(errlogFatal,
+            "mmapConfigure %s: Out of memory.\n",
+            device->name);
+        return -1;
+    }
+    st->offset = strtoul(spec, &end, 0);
+    if (*end != ':')
+        goto usage;
+    bits = strtoul(end+1, &end, 0);
+    if (bits != 8 && bits != 16 && bits != 32 && bits != 64)
+        goto usage;
+    st->width = bits/8;
+    if (*end == ':')
+    {
+        if (strcasecmp(end+1, "w1c") != 0)
+            goto usage;
+        st->w1c = 1;
+    }
+    else if (*end)
+        goto usage;
+    if (st->offset + st->width > device->size || st->offset & (st->width-1))
+    {
+        errlogSevPrintf(errlogFatal,
+            "mmapConfigure %s: Interrupt status register 0x%"Z"x is outside the device or misaligned.\n",
+            device->name, st->offset);
+        free(st);
+        return -1;
+    }
+    if (causes)
+    {
+        const char* p = causes;
+        while (*p)
         {
-            info->intrmissed++;
-            if (mmapDebug >= 1)
-                printf("mmapUioInterruptThread %s: Missed %lld interrupts so far.\n",
-                    device->name, info->intrmissed);
+            if (st->ncauses == MAX_INTR_CAUSES)
+                goto usage;
+            st->masks[st->ncauses] = strtoull(p, &end, 0);
+            if (end == p || (*end && *end != '/'))
+                goto usage;
+            st->allmask |= st->masks[st->ncauses++];
+            p = *end ? end+1 : end;
         }
-        lastnum = intrno;
-
-        mmapInterrupt(arg);
-        if (reenable) write(fd, &reenable, 4);
     }
+    else
+    {
+        /* one cause per bit */
+        for (st->ncauses = 0; st->ncauses < bits; st->ncauses++)
+            st->masks[st->ncauses] = 1ULL << st->ncauses;
+        st->allmask = bits == 64 ? ~0ULL : (1ULL << bits) - 1;
+    }
+    device->intrstatus = st;
+    if (mmapDebug)
+        printf("mmapConfigure %s: interrupt status at 0x%"Z"x %u bit%s with %u causes\n",
+            device->name, st->offset, st->width*8, st->w1c ? " w1c" : "", st->ncauses);
+    return 0;
+usage:
     errlogSevPrintf(errlogFatal,
-        "mmapUioInterruptThread %s: Interrupt handling %s working on %s.\n",
-        device->name, intrno ? "stopped" : "not", info->uioname);
-    close(fd);
+        "mmapConfigure %s: Invalid intrstatus=%s intrcauses=%s. Use intrstatus=offset:bits[:w1c] intrcauses=mask/mask/...\n",
+        device->name, spec, causes ? causes : "");
+    free(st);
+    return -1;
 }
 
-mmapIntrInfo *mmapConnectUioInterrupt(const char* user, regDevice *device, int uionum)
-{
-#define THREADNAMESTRING "Iuio"
-#define GLOBSTRING       "/dev/uio{*[!0-9],}"
-
-    mmapIntrInfo *info = NULL;
-    char threadname[sizeof(THREADNAMESTRING)+sizeof(uionum)*2+sizeof(uionum)/2];
-    char globpattern[sizeof(GLOBSTRING)+sizeof(info->intrvector)*2+sizeof(info->intrvector)/2];
-    int globstatus;
-    glob_t globresults;
-    char *uioname;
-    int fd;
+/* Interrupt acknowledge: register accesses done in the interrupt thread
+   right after wakeup, without a custom interrupt handler.
+*/
 
-    if (mmapDebug)
-        printf("mmapConnectUioInterrupt %s %s: uionum = %d\n",
-            user, device->name, uionum);
+static const char* const mmapIntrAckNames[] = { "", "set", "clear", "write", "w1c", "read" };
 
-    sprintf(globpattern, GLOBSTRING "%u", uionum);
+static void mmapAckInterrupt(regDevice *device)
+{
+    mmapIntrAck* ack;
 
-    if (mmapDebug)
-        printf("mmapConnectUioInterrupt %s %s: glob \"%s\"\n",
-            user, device->name, globpattern);
+    for (ack = device->intrack; ack->op; ack++)
+    {
+        volatile char* reg = device->localbaseaddress + ack->offset;
+        epicsUInt64 value = ack->value;
 
-    globstatus = glob(globpattern, GLOB_BRACE, NULL, &globresults);
-    if (globstatus == GLOB_NOMATCH) {
-        errlogSevPrintf(errlogFatal,
-            "mmapConnectUioInterrupt %s %s: No uio number %u found.\n",
-            user, device->name, uionum);
-        goto fail;
+        if (ack->op == ACK_SET || ack->op == ACK_CLEAR || ack->op == ACK_READ)
+        {
+            epicsUInt64 old;
+            switch (ack->width)
+            {
+                case 1: old = *(volatile epicsUInt8*)reg; break;
+                case 2: old = *(volatile epicsUInt16*)reg; break;
+                case 4: old = *(volatile epicsUInt32*)reg; break;
+                default: old = *(volatile epicsUInt64*)reg; break;
+            }
+            if (ack->op == ACK_READ)
+                continue;
+            value = ack->op == ACK_SET ? old | value : old & ~value;
+        }
+        switch (ack->width)
+        {
+            case 1: *(volatile epicsUInt8*)reg = value; break;
+            case 2: *(volatile epicsUInt16*)reg = value; break;
+            case 4: *(volatile epicsUInt32*)reg = value; break;
+            default: *(volatile epicsUInt64*)reg = value; break;
+        }
     }
-    if (globstatus != 0) {
+    SYNC
+}
+
+/* spec: op:offset:bits[:value]/op:offset:bits[:value]/... */
+static int mmapConfigureIntrAck(regDevice *device, const char* spec)
+{
+    mmapIntrAck* acks;
+    mmapIntrAck* ack;
+    const char* p = spec;
+    unsigned long bits;
+    char* end;
+    int n = 0;
+
+    acks = calloc(MAX_INTR_ACKS + 1, sizeof(mmapIntrAck));
+    if (!acks)
+    {
         errlogSevPrintf(errlogFatal,
-            "mmapConnectUioInterrupt %s %s: glob \"%s\" failed.\n",
-            user, device->name, globpattern);
-        goto fail;
+            "mmapConfigure %s: Out of memory.\n",
+            device->name);
+        return -1;
     }
-    uioname = globresults.gl_pathv[0];
-    if (mmapDebug)
-        printf("mmapConnectUioInterrupt %s %s: Found %s\n",
-            user, device->name, uioname);
-    fd = open(uioname, O_RDWR | O_CLOEXEC);
-    if (fd < 0)
+    while (*p)
     {
-        fd = open(uioname, O_RDONLY | O_CLOEXEC);
-        if (fd < 0) {
+        if (n == MAX_INTR_ACKS)
+            goto usage;
+        ack = &acks[n++];
+        for (ack->op = ACK_READ; ack->op > 0; ack->op--)
+        {
+            size_t len = strlen(mmapIntrAckNames[ack->op]);
+            if (strncasecmp(p, mmapIntrAckNames[ack->op], len) == 0 && p[len] == ':')
+            {
+                p += len + 1;
+                break;
+            }
+        }
+        if (!ack->op)
+            goto usage;
+        ack->offset = strtoul(p, &end, 0);
+        if (*end != ':')
+            goto usage;
+        bits = strtoul(end+1, &end, 0);
+        if (bits != 8 && bits != 16 && bits != 32 && bits != 64)
+            goto usage;
+        ack->width = bits/8;
+        if (ack->op != ACK_READ)
+        {
+            if (*end != ':')
+                goto usage;
+            p = end+1;
+            ack->value = strtoull(p, &end, 0);
+            if (end == p)
+                goto usage;
+        }
+        if (*end && *end != '/')
+            goto usage;
+        p = *end ? end+1 : end;
+        if (ack->offset + ack->width > device->size || ack->offset & (ack->width-1))
+        {
             errlogSevPrintf(errlogFatal,
-                "mmapConnectUioInterrupt %s %s: Cannot open %s: %s\n",
-                user, device->name, uioname, strerror(errno));
-            goto fail;
+                "mmapConfigure %s: Interrupt acknowledge register 0x%"Z"x is outside the device or misaligned.\n",
+                device->name, ack->offset);
+            free(acks);
+            return -1;
         }
         if (mmapDebug)
-            printf("mmapConnectUioInterrupt %s %s: %s is readonly.\n",
-                user, device->name, uioname);
+            printf("mmapConfigure %s: interrupt acknowledge %s 0x%"Z"x %u bit 0x%llx\n",
+                device->name, mmapIntrAckNames[ack->op], ack->offset, ack->width*8,
+                (unsigned long long)ack->value);
     }
+    if (n == 0)
+        goto usage;
+    device->intrack = acks;
+    return 0;
+usage:
+    errlogSevPrintf(errlogFatal,
+        "mmapConfigure %s: Invalid intrack=%s. Use intrack=op:offset:bits[:value]/... with op set, clear, write, w1c or read.\n",
+        device->name, spec);
+    free(acks);
+    return -1;
+}
 
-    info = calloc(sizeof(mmapIntrInfo) + strlen(uioname), 1);
-    if (!info) {
-        errlogSevPrintf(errlogFatal,
-            "mmapConnectUioInterrupt %s %s: Out of memory.\n",
-            user, device->name);
-        goto fail;
-    }
-    info->device = device;
-    info->intrlevel = INTR_UIO;
-    info->intrvector = uionum;
-    info->uiofd = fd;
-    strcpy(info->uioname, uioname);
+#ifdef HAVE_SNAPSHOT
+/* Snapshot: At interrupt time, a region of the device is copied into a
+   buffer from a lock-free pool. The buffer is queued for each callback
+   priority that processes records for this interrupt. Records read from
+   the oldest queued buffer of their priority. When the scan of one
+   priority completes, its buffer is dequeued and recycled when no longer
+   used by any priority.
+*/
 
-    scanIoInit(&info->ioscanpvt);
-    if (!info->ioscanpvt) {
-        errlogSevPrintf(errlogFatal,
-            "mmapConnectUioInterrupt %s %s: scanIoInit failed: %s\n",
-            user, device->name, strerror(errno));
-        goto fail;
-    }
+#define SNAPSHOT_MAX_BUFFERS 32
+#define SNAPSHOT_DEFAULT_BUFFERS 4
+#define SNAPSHOT_QUEUE_SIZE 256
 
-    sprintf(threadname, THREADNAMESTRING "%u", uionum);
-    if (mmapDebug)
-        printf("mmapConnectUioInterrupt %s %s: Starting interrupt thread %s for %s.\n",
-            user, device->name, threadname, uioname);
+typedef struct mmapSnapshotBuffer {
+    int refs;
+    char* data;
+} mmapSnapshotBuffer;
 
-    if (!epicsThreadCreate(threadname, epicsThreadPriorityMax,
-        epicsThreadGetStackSize(epicsThreadStackSmall),
-        mmapUioInterruptThread, info))
+typedef struct mmapSnapshotQueue {
+    unsigned int head;              /* dequeued by scan complete callback */
+    unsigned int tail;              /* enqueued by interrupt */
+    mmapSnapshotBuffer* slots[SNAPSHOT_QUEUE_SIZE];
+} mmapSnapshotQueue;
+
+typedef struct mmapSnapshot {
+    size_t offset;
+    size_t size;
+    unsigned int dlen;
+    unsigned int count;
+    unsigned int freeMask;
+    unsigned long long taken;
+    unsigned long long overruns;
+    unsigned long long served;
+    mmapSnapshotQueue queue[NUM_CALLBACK_PRIORITIES];
+    mmapSnapshotBuffer buffers[SNAPSHOT_MAX_BUFFERS];
+} mmapSnapshot;
+
+static mmapSnapshotBuffer* mmapSnapshotGetBuffer(mmapSnapshot* snap)
+{
+    unsigned int mask = __atomic_load_n(&snap->freeMask, __ATOMIC_ACQUIRE);
+    while (mask)
     {
-        errlogSevPrintf(errlogFatal,
-            "mmapConnectUioInterrupt %s %s: epicsThreadCreate failed: %s\n",
-            user, device->name, strerror(errno));
-        goto fail;
+        unsigned int bit = mask & -mask;
+        if (__atomic_compare_exchange_n(&snap->freeMask, &mask, mask & ~bit, 1, __ATOMIC_ACQ_REL, __ATOMIC_ACQUIRE))
+            return &snap->buffers[__builtin_ctz(bit)];
     }
-    globfree(&globresults);
-    return info;
-fail:
-    free(info);
-    globfree(&globresults);
     return NULL;
 }
-#endif /* HAVE_UIO */
 
-mmapIntrInfo *mmapConnectVmeInterrupt(const char* user, regDevice *device, int intrvector, int intrlevel)
+static void mmapSnapshotRelease(mmapSnapshot* snap, mmapSnapshotBuffer* buffer)
 {
-    mmapIntrInfo *info;
+    if (__atomic_sub_fetch(&buffer->refs, 1, __ATOMIC_ACQ_REL) == 0)
+        __atomic_or_fetch(&snap->freeMask, 1U << (buffer - snap->buffers), __ATOMIC_RELEASE);
+}
 
-    if (intrvector > 0xff)
+static void mmapSnapshotInterrupt(regDevice *device, IOSCANPVT ioscanpvt)
+{
+    mmapSnapshot* snap = device->snapshot;
+    mmapSnapshotBuffer* buffer;
+    unsigned int queued = 0;
+    unsigned int scanned;
+    int prio;
+
+    buffer = mmapSnapshotGetBuffer(snap);
+    if (buffer)
     {
-        intrlevel = intrvector >> 8;
-        intrvector &= 0xff;
+        CACHE_INVALIDATE(device, snap->offset, snap->size);
+        regDevCopy(snap->dlen, snap->size/snap->dlen, device->localbaseaddress + snap->offset, buffer->data, NULL, 0);
+        __atomic_store_n(&buffer->refs, NUM_CALLBACK_PRIORITIES, __ATOMIC_RELEASE);
+        snap->taken++;
     }
+    else
+        snap->overruns++; /* records of this scan will read the device directly */
 
-    if (mmapDebug)
-        printf("mmapConnectVmeInterrupt %s %s: intrvector=%#x intrlevel = %d\n",
-            user, device->name, intrvector, intrlevel);
-
-    if (!intrlevel)
+    for (prio = 0; prio < NUM_CALLBACK_PRIORITIES; prio++)
     {
-        errlogSevPrintf(errlogMajor,
-            "mmapConnectVmeInterrupt %s %s: Warning: No VME interrupt level given. Interrupts for vector %#x may not be enabled.\n",
-            user, device->name, intrvector);
+        mmapSnapshotQueue* q = &snap->queue[prio];
+        if (q->tail - __atomic_load_n(&q->head, __ATOMIC_ACQUIRE) < SNAPSHOT_QUEUE_SIZE)
+        {
+            q->slots[q->tail % SNAPSHOT_QUEUE_SIZE] = buffer;
+            __atomic_store_n(&q->tail, q->tail+1, __ATOMIC_RELEASE);
+            queued |= 1 << prio;
+        }
+        else if (buffer)
+            mmapSnapshotRelease(snap, buffer);
     }
-    else if (intrlevel < 1 || intrlevel > 7)
+
+    scanned = scanIoRequest(ioscanpvt);
+
+    /* remove the buffer again from priorities without records to scan */
+    for (prio = 0; prio < NUM_CALLBACK_PRIORITIES; prio++)
     {
-        errlogSevPrintf(errlogFatal,
-            "mmapConnectVmeInterrupt %s %s: Invalid VME interrupt level %i.\n",
-            user, device->name, intrlevel);
-        return NULL;
+        if ((queued & ~scanned) & (1 << prio))
+        {
+            mmapSnapshotQueue* q = &snap->queue[prio];
+            __atomic_store_n(&q->tail, q->tail-1, __ATOMIC_RELEASE);
+            if (buffer)
+                mmapSnapshotRelease(snap, buffer);
+        }
     }
-    if (intrvector < 1 || intrlevel > 255)
+}
+
+static void mmapSnapshotScanComplete(void *usr, IOSCANPVT ioscanpvt, int prio)
+{
+    regDevice *device = usr;
+    mmapSnapshot* snap = device->snapshot;
+    mmapSnapshotQueue* q = &snap->queue[prio];
+    unsigned int head = q->head;
+
+    if (head != __atomic_load_n(&q->tail, __ATOMIC_ACQUIRE))
     {
-        errlogSevPrintf(errlogFatal,
-            "mmapConnectVmeInterrupt %s %s: Invalid VME interrupt vector %#x.\n",
-            user, device->name, intrlevel);
-        return NULL;
+        mmapSnapshotBuffer* buffer = q->slots[head % SNAPSHOT_QUEUE_SIZE];
+        __atomic_store_n(&q->head, head+1, __ATOMIC_RELEASE);
+        if (buffer)
+            mmapSnapshotRelease(snap, buffer);
     }
+}
 
-    info = calloc(sizeof(mmapIntrInfo), 1);
-    if (!info) {
-        errlogSevPrintf(errlogFatal,
-            "mmapConnectUioInterrupt %s %s: Out of memory.\n",
-            user, device->name);
-        return NULL;
-    }
+/* Returns 1 if data has been read from the snapshot */
+static int mmapSnapshotRead(regDevice *device, size_t offset, unsigned int dlen, size_t nelem, void* pdata, int prio)
+{
+    mmapSnapshot* snap = device->snapshot;
+    mmapSnapshotQueue* q;
+    mmapSnapshotBuffer* buffer;
+    unsigned int head;
+    int refs;
 
-    info->device = device;
-    info->intrlevel = intrlevel;
-    info->intrvector = intrvector;
-    scanIoInit(&info->ioscanpvt);
+    if (prio < 0 || prio >= NUM_CALLBACK_PRIORITIES ||
+        offset < snap->offset || offset + nelem*dlen > snap->offset + snap->size)
+        return 0;
+    q = &snap->queue[prio];
+    head = __atomic_load_n(&q->head, __ATOMIC_ACQUIRE);
+    if (head == __atomic_load_n(&q->tail, __ATOMIC_ACQUIRE))
+        return 0;
+    buffer = q->slots[head % SNAPSHOT_QUEUE_SIZE];
+    if (!buffer)
+        return 0;
+    /* keep buffer from being recycled while we read it */
+    refs = __atomic_load_n(&buffer->refs, __ATOMIC_ACQUIRE);
+    do {
+        if (refs <= 0) return 0;
+    } while (!__atomic_compare_exchange_n(&buffer->refs, &refs, refs+1, 1, __ATOMIC_ACQ_REL, __ATOMIC_ACQUIRE));
+    memcpy(pdata, buffer->data + (offset - snap->offset), nelem*dlen);
+    mmapSnapshotRelease(snap, buffer);
+    snap->served++;
+    return 1;
+}
 
-    if (!info->ioscanpvt)
+static int mmapStartSnapshot(regDevice *device, const char* spec)
+{
+    mmapSnapshot* snap;
+    unsigned long offset, size, count = SNAPSHOT_DEFAULT_BUFFERS;
+    char* end;
+    unsigned int i;
+
+    offset = strtoul(spec, &end, 0);
+    if (*end != ':')
+        goto usage;
+    size = strtoul(end+1, &end, 0);
+    if (*end == ':')
+        count = strtoul(end+1, &end, 0);
+    if (*end || size == 0 || count == 0 || count > SNAPSHOT_MAX_BUFFERS)
+        goto usage;
+    if (offset + size > device->size)
     {
         errlogSevPrintf(errlogFatal,
-            "mmapConnectVmeInterrupt %s %s: scanIoInit failed: %s\n",
-            user, device->name, strerror(errno));
-        free(info);
+            "mmapConfigure %s: Snapshot region 0x%lx:0x%lx exceeds device size 0x%"Z"x.\n",
+            device->name, offset, size, device->size);
+        return -1;
+    }
+    snap = calloc(1, sizeof(mmapSnapshot));
+    if (!snap)
+        goto nomem;
+    snap->offset = offset;
+    snap->size = size;
+    /* use the widest register access that fits the region (up to 32 bit) */
+    for (snap->dlen = 4; (offset | size) & (snap->dlen-1); snap->dlen >>= 1);
+    snap->count = count;
+    for (i = 0; i < count; i++)
+    {
+        snap->buffers[i].data = malloc(size);
+        if (!snap->buffers[i].data)
+            goto nomem;
+        snap->freeMask |= 1U << i;
+    }
+    device->snapshot = snap;
+    if (mmapDebug)
+        printf("mmapConfigure %s: snapshot 0x%lx:0x%lx with %lu buffers\n",
+            device->name, offset, size, count);
+    return 0;
+
+usage:
+    errlogSevPrintf(errlogFatal,
+        "mmapConfigure %s: Invalid snapshot=%s. Use snapshot=offset:size[:buffers] with up to %d buffers.\n",
+        device->name, spec, SNAPSHOT_MAX_BUFFERS);
+    return -1;
+nomem:
+    errlogSevPrintf(errlogFatal,
+        "mmapConfigure %s: Out of memory for snapshot buffers.\n",
+        device->name);
+    return -1;
+}
+#endif /* HAVE_SNAPSHOT */
+
+/* Binary trace: each thread records events into its own ring buffer
+   without locks or printf. mmapTraceDump decodes them on demand.
+*/
+#define TRACE_READ      1
+#define TRACE_WRITE     2
+#define TRACE_INTR      3   /* offset: vector, len: count */
+#define TRACE_WAKEUP    4   /* offset: received number, len: bytes */
+#define TRACE_FLUSH     5   /* len: number of writes */
+#define TRACE_STATUS    6   /* offset: status register, len: status */
+
+#define TRACE_MAP       1
+#define TRACE_DIRECT    2
+#define TRACE_DMA       3
+#define TRACE_QUEUE     4
+#define TRACE_MASKED    5
+#define TRACE_FILE      6
+#define TRACE_SNAPSHOT  7
+#define TRACE_SHADOW    8
+#define TRACE_PARALLEL  9
+#define TRACE_MIRROR    10
+#define TRACE_VIEW      11
+#define TRACE_CHUNK     12
+#define TRACE_ATOMIC    13
+
+#ifdef HAVE_TRACE
+static const char* mmapTraceEvents[] = { "", "read", "write", "intr", "wakeup", "flush", "status" };
+static const char* mmapTracePaths[] = { "", "map", "direct", "dma", "queue", "masked", "file", "snapshot", "shadow", "parallel", "mirror", "view", "chunk", "atomic" };
+
+#define TRACE_SIZE 2048 /* entries per thread, power of 2 */
+
+typedef struct mmapTraceEntry {
+    epicsUInt32 seq;                /* number of entry + 1, 0 while being written */
+    epicsUInt16 event;
+    epicsUInt16 path;
+    epicsUInt64 time;               /* CLOCK_MONOTONIC in ns */
+    regDevice* device;
+    size_t offset;
+    size_t len;
+} mmapTraceEntry;
+
+typedef struct mmapTraceRing {
+    struct mmapTraceRing* next;
+    char thread[16];
+    epicsUInt32 count;
+    mmapTraceEntry entries[TRACE_SIZE];
+} mmapTraceRing;
+
+static mmapTraceRing* mmapTraceRings;
+static epicsThreadPrivateId mmapTraceKey;
+static epicsThreadOnceId mmapTraceOnce = EPICS_THREAD_ONCE_INIT;
+
+static void mmapTraceInit(void* arg __attribute__((unused)))
+{
+    mmapTraceKey = epicsThreadPrivateCreate();
+}
+
+static mmapTraceRing* mmapTraceNewRing(void)
+{
+    mmapTraceRing* ring;
+
+    epicsThreadOnce(&mmapTraceOnce, mmapTraceInit, NULL);
+    ring = calloc(1, sizeof(mmapTraceRing));
+    if (!ring) return NULL;
+    strncpy(ring->thread, epicsThreadGetNameSelf(), sizeof(ring->thread)-1);
+    /* rings are never freed, so pushing needs no ABA protection */
+    ring->next = __atomic_load_n(&mmapTraceRings, __ATOMIC_RELAXED);
+    while (!__atomic_compare_exchange_n(&mmapTraceRings, &ring->next, ring,
+        1, __ATOMIC_RELEASE, __ATOMIC_RELAXED));
+    epicsThreadPrivateSet(mmapTraceKey, ring);
+    return ring;
+}
+
+static void mmapTraceEvent(int event, regDevice* device, size_t offset, size_t len, int path)
+{
+    mmapTraceRing* ring = mmapTraceKey ? epicsThreadPrivateGet(mmapTraceKey) : NULL;
+    mmapTraceEntry* entry;
+    struct timespec now;
+
+    if (!ring && !(ring = mmapTraceNewRing()))
+        return;
+    entry = &ring->entries[ring->count & (TRACE_SIZE-1)];
+    __atomic_store_n(&entry->seq, 0, __ATOMIC_RELAXED);
+    __atomic_thread_fence(__ATOMIC_RELEASE);
+    clock_gettime(CLOCK_MONOTONIC, &now);
+    entry->time = (epicsUInt64)now.tv_sec * 1000000000 + now.tv_nsec;
+    entry->event = event;
+    entry->path = path;
+    entry->device = device;
+    entry->offset = offset;
+    entry->len = len;
+    __atomic_store_n(&entry->seq, ++ring->count, __ATOMIC_RELEASE);
+}
+
+#define TRACE(event, device, offset, len, path) \
+    do { if (mmapTrace) mmapTraceEvent(event, device, offset, len, path); } while (0)
+
+typedef struct {
+    mmapTraceEntry entry;
+    const char* thread;
+} mmapTraceRecord;
+
+static int mmapTraceCompare(const void* a, const void* b)
+{
+    epicsUInt64 ta = ((const mmapTraceRecord*)a)->entry.time;
+    epicsUInt64 tb = ((const mmapTraceRecord*)b)->entry.time;
+    return ta < tb ? -1 : ta > tb;
+}
+
+int mmapTraceDump(const char* name, const char* event, int count)
+{
+    mmapTraceRing* ring;
+    mmapTraceRecord* records;
+    size_t n = 0, nrings = 0, i;
+
+    if (name && (!name[0] || strcmp(name, "*") == 0)) name = NULL;
+    if (event && (!event[0] || strcmp(event, "*") == 0)) event = NULL;
+    if (count <= 0) count = 100;
+
+    for (ring = __atomic_load_n(&mmapTraceRings, __ATOMIC_ACQUIRE); ring; ring = ring->next)
+        nrings++;
+    if (nrings == 0)
+    {
+        printf("no trace recorded%s\n", mmapTrace ? "" : ", set mmapTrace=1 to enable");
+        return 0;
+    }
+    records = malloc(nrings * TRACE_SIZE * sizeof(mmapTraceRecord));
+    if (!records)
+    {
+        errlogSevPrintf(errlogMajor,
+            "mmapTraceDump: Out of memory.\n");
+        return -1;
+    }
+    for (ring = __atomic_load_n(&mmapTraceRings, __ATOMIC_ACQUIRE); ring; ring = ring->next)
+    {
+        for (i = 0; i < TRACE_SIZE; i++)
+        {
+            mmapTraceEntry* entry = &ring->entries[i];
+            mmapTraceRecord* record = &records[n];
+            epicsUInt32 seq = __atomic_load_n(&entry->seq, __ATOMIC_ACQUIRE);
+
+            if (seq == 0) continue;
+            record->entry = *entry;
+            __atomic_thread_fence(__ATOMIC_ACQUIRE);
+            /* skip entries overwritten while copying */
+            if (__atomic_load_n(&entry->seq, __ATOMIC_RELAXED) != seq) continue;
+            if (name && strcmp(record->entry.device->name, name) != 0) continue;
+            if (event && record->entry.event < sizeof(mmapTraceEvents)/sizeof(mmapTraceEvents[0]) &&
+                strcmp(mmapTraceEvents[record->entry.event], event) != 0) continue;
+            record->thread = ring->thread;
+            n++;
+        }
+    }
+    qsort(records, n, sizeof(mmapTraceRecord), mmapTraceCompare);
+    for (i = n > (size_t)count ? n - count : 0; i < n; i++)
+    {
+        mmapTraceEntry* entry = &records[i].entry;
+        printf("%llu.%09llu %-15s %-6s %-15s 0x%08"Z"x %8"Z"u %s\n",
+            (unsigned long long)entry->time / 1000000000,
+            (unsigned long long)entry->time % 1000000000,
+            records[i].thread,
+            mmapTraceEvents[entry->event],
+            entry->device->name,
+            entry->offset, entry->len,
+            mmapTracePaths[entry->path]);
+    }
+    free(records);
+    return 0;
+}
+#else /* !HAVE_TRACE */
+#define TRACE(event, device, offset, len, path)
+#endif /* !HAVE_TRACE */
+
+#ifdef HAVE_CAPTURE
+/* Capture: at each interrupt, a region is copied into a free slot
+   (lock-free, never blocks) and a writer thread appends it with a
+   time stamp to a mapped file.
+*/
+
+#define CAPTURE_MAGIC "mmapcap1"
+#define CAPTURE_DEFAULT_SLOTS 64
+#define CAPTURE_GROW 0x1000000
+
+typedef struct mmapCaptureHeader {
+    char magic[8];
+    epicsUInt64 offset;             /* of the captured region in the device */
+    epicsUInt64 size;               /* of the captured region */
+    epicsUInt64 count;              /* number of records */
+} mmapCaptureHeader;
+
+typedef struct mmapCaptureRecord {
+    epicsUInt64 time;               /* CLOCK_REALTIME in ns */
+    epicsInt32 vector;
+    epicsUInt32 reserved;
+    /* followed by the region, padded to 8 bytes */
+} mmapCaptureRecord;
+
+typedef struct mmapCaptureSlot {
+    size_t seq;
+    epicsUInt64 time;
+    int vector;
+} mmapCaptureSlot;
+
+typedef struct mmapCapture {
+    size_t tail;
+    char pad[64];
+    size_t head;
+    size_t nslots;                  /* power of 2 */
+    size_t offset;
+    size_t size;
+    size_t recordsize;
+    unsigned int dlen;
+    char* file;
+    int fd;
+    int closed;
+    char* map;
+    size_t mapsize;
+    size_t used;
+    epicsEventId wakeup;
+    epicsMutexId lock;
+    unsigned long long records;
+    unsigned long long drops;
+    char* data;                     /* nslots * size */
+    mmapCaptureSlot slots[1];
+} mmapCapture;
+
+static void mmapCaptureInterrupt(regDevice *device, int vector)
+{
+    mmapCapture* cap = device->capture;
+    size_t pos = __atomic_load_n(&cap->tail, __ATOMIC_RELAXED);
+    mmapCaptureSlot* slot;
+    struct timespec now;
+
+    while (1)
+    {
+        size_t seq;
+        slot = &cap->slots[pos & (cap->nslots-1)];
+        seq = __atomic_load_n(&slot->seq, __ATOMIC_ACQUIRE);
+        if (seq == pos)
+        {
+            if (__atomic_compare_exchange_n(&cap->tail, &pos, pos+1, 1, __ATOMIC_RELAXED, __ATOMIC_RELAXED))
+                break;
+        }
+        else if ((ptrdiff_t)(seq - pos) < 0)
+        {
+            /* writer too slow */
+            __atomic_add_fetch(&cap->drops, 1, __ATOMIC_RELAXED);
+            return;
+        }
+        else
+            pos = __atomic_load_n(&cap->tail, __ATOMIC_RELAXED);
+    }
+    clock_gettime(CLOCK_REALTIME, &now);
+    slot->time = (epicsUInt64)now.tv_sec * 1000000000 + now.tv_nsec;
+    slot->vector = vector;
+    CACHE_INVALIDATE(device, cap->offset, cap->size);
+    regDevCopy(cap->dlen, cap->size/cap->dlen, device->localbaseaddress+cap->offset,
+        cap->data + (pos & (cap->nslots-1)) * cap->size, NULL, 0);
+    __atomic_store_n(&slot->seq, pos+1, __ATOMIC_RELEASE);
+    epicsEventSignal(cap->wakeup);
+}
+#endif /* HAVE_CAPTURE */
+
+#ifdef HAVE_PUBLISH
+/* Publication: snapshots of a region in reference counted buffers which
+   other modules reference instead of copying, see mmapPublish.h.
+*/
+#define MAX_PUBLISH_BUFFERS 64
+#define MAX_SUBSCRIBERS 8
+
+struct mmapBuffer {
+    struct mmapPublisher* pub;
+    int refs;
+    epicsUInt64 id;
+    epicsTimeStamp time;
+    char* data;
+};
+
+typedef struct mmapPublisher {
+    regDevice *device;
+    size_t offset;
+    size_t size;
+    unsigned int dlen;
+    unsigned int nbuffers;
+    unsigned int nsubscribers;
+    mmapPublishCallback callbacks[MAX_SUBSCRIBERS];
+    void* usrs[MAX_SUBSCRIBERS];
+    epicsMutexId lock;
+    epicsUInt64 taken;
+    unsigned long long overruns;
+    struct mmapBuffer buffers[MAX_PUBLISH_BUFFERS];
+} mmapPublisher;
+
+const void* mmapBufferData(const mmapBuffer* buffer)
+{
+    return buffer->data;
+}
+
+size_t mmapBufferSize(const mmapBuffer* buffer)
+{
+    return buffer->pub->size;
+}
+
+size_t mmapBufferOffset(const mmapBuffer* buffer)
+{
+    return buffer->pub->offset;
+}
+
+epicsUInt64 mmapBufferId(const mmapBuffer* buffer)
+{
+    return buffer->id;
+}
+
+const epicsTimeStamp* mmapBufferTime(const mmapBuffer* buffer)
+{
+    return &buffer->time;
+}
+
+void mmapBufferRetain(mmapBuffer* buffer)
+{
+    __atomic_add_fetch(&buffer->refs, 1, __ATOMIC_RELAXED);
+}
+
+void mmapBufferRelease(mmapBuffer* buffer)
+{
+    __atomic_sub_fetch(&buffer->refs, 1, __ATOMIC_RELEASE);
+}
+
+static int mmapPublishTake(regDevice *device)
+{
+    mmapPublisher* pub = device->publisher;
+    mmapBuffer* buffer = NULL;
+    unsigned int i, n;
+    int unused;
+
+    epicsMutexMustLock(pub->lock);
+    for (i = 0; i < pub->nbuffers; i++)
+    {
+        unused = 0;
+        if (__atomic_compare_exchange_n(&pub->buffers[i].refs, &unused, 1, 0, __ATOMIC_ACQUIRE, __ATOMIC_RELAXED))
+        {
+            buffer = &pub->buffers[i];
+            break;
+        }
+    }
+    if (!buffer)
+    {
+        /* all buffers still referenced by subscribers */
+        pub->overruns++;
+        epicsMutexUnlock(pub->lock);
+        return 1;
+    }
+    CACHE_INVALIDATE(device, pub->offset, pub->size);
+    regDevCopy(pub->dlen, pub->size/pub->dlen, device->localbaseaddress + pub->offset, buffer->data, NULL, 0);
+    epicsTimeGetCurrent(&buffer->time);
+    buffer->id = ++pub->taken;
+    epicsMutexUnlock(pub->lock);
+
+    n = __atomic_load_n(&pub->nsubscribers, __ATOMIC_ACQUIRE);
+    for (i = 0; i < n; i++)
+        pub->callbacks[i](pub->usrs[i], buffer);
+    mmapBufferRelease(buffer);
+    return 0;
+}
+
+static regDevice* mmapFindPublisher(const char* name, const char* caller)
+{
+    regDevice *device;
+
+    for (device = mmapDevices; device; device = device->next)
+        if (strcmp(device->name, name) == 0) break;
+    if (!device || !device->publisher)
+    {
+        errlogSevPrintf(errlogMajor,
+            "%s: %s is not an mmap device with the publish option.\n", caller, name);
         return NULL;
     }
+    return device;
+}
+
+int mmapPublishSubscribe(const char* name, mmapPublishCallback callback, void* usr)
+{
+    regDevice *device;
+    mmapPublisher* pub;
+
+    if (!name || !callback || !(device = mmapFindPublisher(name, "mmapPublishSubscribe")))
+        return -1;
+    pub = device->publisher;
+    epicsMutexMustLock(pub->lock);
+    if (pub->nsubscribers == MAX_SUBSCRIBERS)
+    {
+        epicsMutexUnlock(pub->lock);
+        errlogSevPrintf(errlogMajor,
+            "mmapPublishSubscribe: %s has already %d subscribers.\n", name, MAX_SUBSCRIBERS);
+        return -1;
+    }
+    pub->callbacks[pub->nsubscribers] = callback;
+    pub->usrs[pub->nsubscribers] = usr;
+    __atomic_store_n(&pub->nsubscribers, pub->nsubscribers + 1, __ATOMIC_RELEASE);
+    epicsMutexUnlock(pub->lock);
+    return 0;
+}
+
+int mmapPublishTrigger(const char* name)
+{
+    regDevice *device;
+
+    if (!name || !(device = mmapFindPublisher(name, "mmapPublishTrigger")))
+        return -1;
+    return mmapPublishTake(device);
+}
+
+static int mmapStartPublish(regDevice *device, const char* spec)
+{
+    mmapPublisher* pub;
+    unsigned long offset, size, n = 4, i;
+    char* end;
+
+    /* offset:size[:n] */
+    offset = strtoul(spec, &end, 0);
+    if (*end != ':')
+        goto usage;
+    size = strtoul(end+1, &end, 0);
+    if (*end == ':')
+        n = strtoul(end+1, &end, 0);
+    if (*end || size == 0 || n == 0 || n > MAX_PUBLISH_BUFFERS)
+        goto usage;
+    if (offset + size > device->size)
+    {
+        errlogSevPrintf(errlogFatal,
+            "mmapConfigure %s: Publish region 0x%lx:0x%lx exceeds device size 0x%"Z"x.\n",
+            device->name, offset, size, device->size);
+        return -1;
+    }
+    pub = calloc(1, sizeof(mmapPublisher));
+    if (!pub)
+        goto nomem;
+    pub->device = device;
+    pub->offset = offset;
+    pub->size = size;
+    pub->nbuffers = n;
+    for (pub->dlen = 8; (offset | size) & (pub->dlen-1); pub->dlen >>= 1);
+    for (i = 0; i < n; i++)
+    {
+        pub->buffers[i].pub = pub;
+        pub->buffers[i].data = malloc(size);
+        if (!pub->buffers[i].data)
+            goto nomem;
+    }
+    pub->lock = epicsMutexMustCreate();
+    device->publisher = pub;
+    if (mmapDebug)
+        printf("mmapConfigure %s: publish 0x%lx:0x%lx in %lu buffers\n",
+            device->name, offset, size, n);
+    return 0;
+
+nomem:
+    errlogSevPrintf(errlogFatal,
+        "mmapConfigure %s: Out of memory for publish buffers.\n",
+        device->name);
+    return -1;
+usage:
+    errlogSevPrintf(errlogFatal,
+        "mmapConfigure %s: Invalid publish=%s. Use publish=offset:size[:n] with n <= %d.\n",
+        device->name, spec, MAX_PUBLISH_BUFFERS);
+    return -1;
+}
+#endif /* HAVE_PUBLISH */
+
+#ifdef HAVE_EXPORT
+/* Export: a read-only copy of a device region in a file (e.g. in /dev/shm)
+   for other processes, see mmapExportHeader in mmapProducer.h.
+   The generation counter is odd while the data is updated.
+*/
+typedef struct mmapExport {
+    char* path;
+    size_t offset;
+    size_t size;
+    double period;                  /* 0: no periodic update */
+    epicsMutexId lock;
+    mmapExportHeader* header;
+    char* data;
+    unsigned long long updates;
+} mmapExport;
+
+/* Copy the overlap of src (device offset srcoffset, len bytes) with the exported region */
+static void mmapExportUpdate(regDevice *device, volatile char* src, size_t srcoffset, size_t len)
+{
+    mmapExport* exp = device->export;
+    size_t start = srcoffset > exp->offset ? srcoffset : exp->offset;
+    size_t end = srcoffset + len < exp->offset + exp->size ? srcoffset + len : exp->offset + exp->size;
+    unsigned int dlen;
+    struct timespec now;
+
+    if (start >= end)
+        return;
+    for (dlen = 8; (start | end) & (dlen-1); dlen >>= 1);
+    epicsMutexMustLock(exp->lock);
+    __atomic_store_n(&exp->header->generation, exp->header->generation + 1, __ATOMIC_RELAXED);
+    __atomic_thread_fence(__ATOMIC_RELEASE);
+    regDevCopy(dlen, (end - start)/dlen, src + start - srcoffset, exp->data + start - exp->offset, NULL, 0);
+    clock_gettime(CLOCK_REALTIME, &now);
+    exp->header->timestamp = (uint64_t)now.tv_sec * 1000000000 + now.tv_nsec;
+    __atomic_store_n(&exp->header->generation, exp->header->generation + 1, __ATOMIC_RELEASE);
+    exp->updates++;
+    epicsMutexUnlock(exp->lock);
+}
+
+static void mmapExportFromDevice(regDevice *device)
+{
+    mmapExport* exp = device->export;
+
+    CACHE_INVALIDATE(device, exp->offset, exp->size);
+    mmapExportUpdate(device, device->localbaseaddress + exp->offset, exp->offset, exp->size);
+}
+
+static void mmapExportThread(void* arg)
+{
+    regDevice *device = arg;
+
+    while (1)
+    {
+        epicsThreadSleep(device->export->period);
+        mmapExportFromDevice(device);
+    }
+}
+
+static int mmapStartExport(regDevice *device, const char* spec)
+{
+    mmapExport* exp;
+    unsigned long offset = 0, size = device->size;
+    double period = 0;
+    char threadname[32];
+    const char* colon;
+    char* end;
+    void* map;
+    int fd;
+
+    /* path[:offset:size[:seconds]] */
+    exp = calloc(1, sizeof(mmapExport));
+    if (!exp)
+    {
+        errlogSevPrintf(errlogFatal,
+            "mmapConfigure %s: Out of memory for export.\n",
+            device->name);
+        return -1;
+    }
+    colon = strchr(spec, ':');
+    exp->path = colon ? strndup(spec, colon - spec) : strdup(spec);
+    if (colon)
+    {
+        offset = strtoul(colon+1, &end, 0);
+        if (*end != ':')
+            goto usage;
+        size = strtoul(end+1, &end, 0);
+        if (*end == ':')
+        {
+            period = strtod(end+1, &end);
+            if (period <= 0)
+                goto usage;
+        }
+        if (*end || size == 0)
+            goto usage;
+    }
+    if (offset + size > device->size)
+    {
+        errlogSevPrintf(errlogFatal,
+            "mmapConfigure %s: Export region 0x%lx:0x%lx exceeds device size 0x%"Z"x.\n",
+            device->name, offset, size, device->size);
+        return -1;
+    }
+    fd = open(exp->path, O_RDWR | O_CREAT | O_TRUNC | O_CLOEXEC, 0644);
+    if (fd < 0 || ftruncate(fd, sizeof(mmapExportHeader) + size) != 0)
+    {
+        errlogSevPrintf(errlogFatal,
+            "mmapConfigure %s: Cannot create export file %s: %s\n",
+            device->name, exp->path, strerror(errno));
+        if (fd >= 0) close(fd);
+        return -1;
+    }
+    map = mmap(NULL, sizeof(mmapExportHeader) + size, PROT_READ|PROT_WRITE, MAP_SHARED, fd, 0);
+    close(fd);
+    if (map == MAP_FAILED)
+    {
+        errlogSevPrintf(errlogFatal,
+            "mmapConfigure %s: Cannot map export file %s: %s\n",
+            device->name, exp->path, strerror(errno));
+        return -1;
+    }
+    exp->header = map;
+    exp->data = (char*)map + sizeof(mmapExportHeader);
+    exp->offset = offset;
+    exp->size = size;
+    exp->period = period;
+    exp->lock = epicsMutexMustCreate();
+    exp->header->offset = offset;
+    exp->header->size = size;
+    strncpy(exp->header->device, device->name, sizeof(exp->header->device)-1);
+    memcpy(exp->header->magic, MMAP_EXPORT_MAGIC, sizeof(exp->header->magic));
+    device->export = exp;
+    mmapExportFromDevice(device);
+
+    if (period > 0)
+    {
+        sprintf(threadname, "%.24s-export", device->name);
+        if (!epicsThreadCreate(threadname, epicsThreadPriorityLow,
+            epicsThreadGetStackSize(epicsThreadStackSmall),
+            mmapExportThread, device))
+        {
+            errlogSevPrintf(errlogFatal,
+                "mmapConfigure %s: epicsThreadCreate for export failed: %s\n",
+                device->name, strerror(errno));
+            device->export = NULL;
+            return -1;
+        }
+    }
+    if (mmapDebug)
+        printf("mmapConfigure %s: export 0x%lx:0x%lx to %s\n",
+            device->name, offset, size, exp->path);
+    return 0;
+
+usage:
+    errlogSevPrintf(errlogFatal,
+        "mmapConfigure %s: Invalid export=%s. Use export=file[:offset:size[:seconds]].\n",
+        device->name, spec);
+    return -1;
+}
+
+/* In block mode, each read of the device updates the export
+   from the data just read (still in device byte order)
+*/
+#define EXPORT_BLOCK_READ(device, data, offset, len) \
+    do { if ((device)->export && ((device)->flags & BLOCK_DEVICE)) \
+        mmapExportUpdate((device), (data), (offset), (len)); } while (0)
+#else /* !HAVE_EXPORT */
+#define EXPORT_BLOCK_READ(device, data, offset, len)
+#endif /* !HAVE_EXPORT */
+
+#ifdef HAVE_MIRROR
+/* Mirror: a RAM copy of a register region, refreshed periodically by a
+   background thread or at each interrupt. Reads from the region are
+   served from the copy with memory latency.
+*/
+typedef struct mmapMirror {
+    size_t offset;
+    size_t size;
+    unsigned int dlen;
+    double period;                  /* 0: refresh at interrupts */
+    int scan;                       /* I/O Intr after each periodic refresh */
+    epicsMutexId lock;
+    unsigned long long refreshes;
+    unsigned long long reads;
+    char* staging;                  /* bus reads go here without holding the lock */
+    char* data;
+} mmapMirror;
+
+static void mmapMirrorRefresh(regDevice *device)
+{
+    mmapMirror* mirror = device->mirror;
+
+    CACHE_INVALIDATE(device, mirror->offset, mirror->size);
+    regDevCopy(mirror->dlen, mirror->size/mirror->dlen, device->localbaseaddress+mirror->offset,
+        mirror->staging, NULL, 0);
+    epicsMutexMustLock(mirror->lock);
+    memcpy(mirror->data, mirror->staging, mirror->size);
+    mirror->refreshes++;
+    epicsMutexUnlock(mirror->lock);
+#ifdef HAVE_EXPORT
+    if (device->export)
+        mmapExportUpdate(device, mirror->staging, mirror->offset, mirror->size);
+#endif /* HAVE_EXPORT */
+}
+#endif /* HAVE_MIRROR */
+
+void mmapInterrupt(void *arg)
+{
+    mmapIntrInfo *info = arg;
+    regDevice *device = info->device;
+    epicsUInt64 status = 0;
+    info->intrcount++;
+    TRACE(TRACE_INTR, device, info->intrvector, info->intrcount, 0);
+    /* latch the status before an acknowledge may clear it */
+    if (device->intrstatus)
+    {
+        status = mmapReadIntrStatus(device);
+        TRACE(TRACE_STATUS, device, device->intrstatus->offset, status, 0);
+    }
+    if (device->intrack)
+        mmapAckInterrupt(device);
+    if (device->intrhandler)
+    {
+        if (device->intrhandler(device) != 0) return;
+    }
+#ifdef HAVE_CAPTURE
+    if (device->capture)
+        mmapCaptureInterrupt(device, info->intrvector);
+#endif /* HAVE_CAPTURE */
+#ifdef HAVE_PUBLISH
+    if (device->publisher)
+        mmapPublishTake(device);
+#endif /* HAVE_PUBLISH */
+#ifdef HAVE_MIRROR
+    /* refresh before records read the mirror */
+    if (device->mirror && device->mirror->period == 0)
+        mmapMirrorRefresh(device);
+#endif /* HAVE_MIRROR */
+#ifdef HAVE_EXPORT
+    /* block transfers and mirror refreshes update the export themselves */
+    if (device->export && !(device->flags & BLOCK_DEVICE) && !device->mirror)
+        mmapExportFromDevice(device);
+#endif /* HAVE_EXPORT */
+    if (device->intrstatus)
+        mmapDemuxInterrupt(info, status);
+#ifdef HAVE_SNAPSHOT
+    if (device->snapshot)
+    {
+        mmapSnapshotInterrupt(device, info->ioscanpvt);
+        return;
+    }
+#endif /* HAVE_SNAPSHOT */
+    scanIoRequest(info->ioscanpvt);
+    if (info->shardsets)
+    {
+        /* each shard is a separate callback request, parallel callback threads can process them concurrently */
+        mmapShardSet* set;
+        unsigned int i;
+        for (set = info->shardsets; set; set = set->next)
+            for (i = 0; i < set->device->shards; i++)
+                if (set->shards[i])
+                    scanIoRequest(set->shards[i]);
+    }
+}
+
+#ifdef HAVE_CAPTURE
+static int mmapCaptureGrow(mmapCapture* cap, size_t need)
+{
+    size_t newsize = cap->mapsize + (need > CAPTURE_GROW ? need : CAPTURE_GROW);
+    char* map;
+
+    if (ftruncate(cap->fd, newsize) != 0)
+        return -1;
+    map = mmap(NULL, newsize, PROT_READ|PROT_WRITE, MAP_SHARED, cap->fd, 0);
+    if (map == MAP_FAILED)
+        return -1;
+    if (cap->map)
+        munmap(cap->map, cap->mapsize);
+    cap->map = map;
+    cap->mapsize = newsize;
+    return 0;
+}
+
+static void mmapCaptureDrain(regDevice *device)
+{
+    mmapCapture* cap = device->capture;
+    mmapCaptureSlot* slot;
+    mmapCaptureRecord* record;
+
+    epicsMutexMustLock(cap->lock);
+    while (!cap->closed)
+    {
+        slot = &cap->slots[cap->head & (cap->nslots-1)];
+        if (__atomic_load_n(&slot->seq, __ATOMIC_ACQUIRE) != cap->head+1)
+            break; /* empty */
+        if (cap->used + cap->recordsize > cap->mapsize &&
+            mmapCaptureGrow(cap, cap->recordsize) != 0)
+        {
+            if (!cap->drops)
+                errlogSevPrintf(errlogMajor,
+                    "mmapCaptureDrain %s: Cannot grow %s: %s\n",
+                    device->name, cap->file, strerror(errno));
+            cap->drops++;
+        }
+        else
+        {
+            record = (mmapCaptureRecord*)(cap->map + cap->used);
+            record->time = slot->time;
+            record->vector = slot->vector;
+            record->reserved = 0;
+            memcpy(record + 1, cap->data + (cap->head & (cap->nslots-1)) * cap->size, cap->size);
+            cap->used += cap->recordsize;
+            cap->records++;
+            ((mmapCaptureHeader*)cap->map)->count = cap->records;
+        }
+        __atomic_store_n(&slot->seq, cap->head + cap->nslots, __ATOMIC_RELEASE);
+        cap->head++;
+    }
+    epicsMutexUnlock(cap->lock);
+}
+
+static void mmapCaptureThread(void* arg)
+{
+    regDevice *device = arg;
+
+    while (!device->capture->closed)
+    {
+        epicsEventMustWait(device->capture->wakeup);
+        mmapCaptureDrain(device);
+    }
+}
+
+static void mmapCaptureExit(void* arg)
+{
+    regDevice *device = arg;
+    mmapCapture* cap = device->capture;
+
+    mmapCaptureDrain(device);
+    epicsMutexMustLock(cap->lock);
+    cap->closed = 1;
+    munmap(cap->map, cap->mapsize);
+    if (ftruncate(cap->fd, cap->used) != 0)
+        errlogSevPrintf(errlogMajor,
+            "mmapCaptureExit %s: Cannot truncate %s: %s\n",
+            device->name, cap->file, strerror(errno));
+    close(cap->fd);
+    epicsMutexUnlock(cap->lock);
+    epicsEventSignal(cap->wakeup);
+    if (mmapDebug)
+        printf("mmapCaptureExit %s: %llu records written to %s, %llu dropped\n",
+            device->name, cap->records, cap->file, cap->drops);
+}
+
+static void mmapCaptureFree(mmapCapture* cap)
+{
+    if (!cap)
+        return;
+    if (cap->map)
+        munmap(cap->map, cap->mapsize);
+    if (cap->fd >= 0)
+        close(cap->fd);
+    free(cap->data);
+    free(cap->file);
+    free(cap);
+}
+
+static int mmapStartCapture(regDevice *device, const char* spec)
+{
+    mmapCapture* cap = NULL;
+    mmapCaptureHeader* header;
+    unsigned long offset, size, nslots = CAPTURE_DEFAULT_SLOTS, n;
+    char threadname[32];
+    const char* colon;
+    char* end;
+
+    /* file:offset:size[:slots] */
+    colon = strchr(spec, ':');
+    if (!colon || colon == spec)
+        goto usage;
+    offset = strtoul(colon+1, &end, 0);
+    if (*end != ':')
+        goto usage;
+    size = strtoul(end+1, &end, 0);
+    if (*end == ':')
+        nslots = strtoul(end+1, &end, 0);
+    if (*end || size == 0 || nslots == 0)
+        goto usage;
+    if (offset + size > device->size)
+    {
+        errlogSevPrintf(errlogFatal,
+            "mmapConfigure %s: Capture region 0x%lx:0x%lx exceeds device size 0x%"Z"x.\n",
+            device->name, offset, size, device->size);
+        return -1;
+    }
+    for (n = 1; n < nslots; n <<= 1);
+    cap = calloc(1, sizeof(mmapCapture) + (n-1) * sizeof(mmapCaptureSlot));
+    if (!cap)
+        goto nomem;
+    cap->fd = -1;
+    cap->file = strndup(spec, colon - spec);
+    if (!cap->file || !(cap->data = malloc(n * size)))
+        goto nomem;
+    cap->nslots = n;
+    cap->offset = offset;
+    cap->size = size;
+    cap->recordsize = sizeof(mmapCaptureRecord) + ((size + 7) & ~7);
+    for (cap->dlen = 4; (offset | size) & (cap->dlen-1); cap->dlen >>= 1);
+    for (n = 0; n < cap->nslots; n++)
+        cap->slots[n].seq = n;
+    cap->fd = open(cap->file, O_RDWR | O_CREAT | O_TRUNC | O_CLOEXEC, 0666);
+    if (cap->fd < 0 || mmapCaptureGrow(cap, sizeof(mmapCaptureHeader)) != 0)
+    {
+        errlogSevPrintf(errlogFatal,
+            "mmapConfigure %s: Cannot create capture file %s: %s\n",
+            device->name, cap->file, strerror(errno));
+        goto fail;
+    }
+    header = (mmapCaptureHeader*)cap->map;
+    memcpy(header->magic, CAPTURE_MAGIC, 8);
+    header->offset = offset;
+    header->size = size;
+    header->count = 0;
+    cap->used = sizeof(mmapCaptureHeader);
+    cap->wakeup = epicsEventMustCreate(epicsEventEmpty);
+    cap->lock = epicsMutexMustCreate();
+    device->capture = cap;
+
+    sprintf(threadname, "%.24s-cap", device->name);
+    if (!epicsThreadCreate(threadname, epicsThreadPriorityLow,
+        epicsThreadGetStackSize(epicsThreadStackSmall),
+        mmapCaptureThread, device))
+    {
+        errlogSevPrintf(errlogFatal,
+            "mmapConfigure %s: epicsThreadCreate for capture failed: %s\n",
+            device->name, strerror(errno));
+        device->capture = NULL;
+        epicsEventDestroy(cap->wakeup);
+        epicsMutexDestroy(cap->lock);
+        goto fail;
+    }
+    epicsAtExit(mmapCaptureExit, device);
+    if (mmapDebug)
+        printf("mmapConfigure %s: capture 0x%lx:0x%lx to %s with %"Z"u slots\n",
+            device->name, offset, size, cap->file, cap->nslots);
+    return 0;
+
+usage:
+    errlogSevPrintf(errlogFatal,
+        "mmapConfigure %s: Invalid capture=%s. Use capture=file:offset:size[:slots].\n",
+        device->name, spec);
+    return -1;
+nomem:
+    errlogSevPrintf(errlogFatal,
+        "mmapConfigure %s: Out of memory for capture.\n",
+        device->name);
+fail:
+    mmapCaptureFree(cap);
+    return -1;
+}
+
+/* Replay: a thread copies the captured regions into a sim device with the
+   recorded timing, scaled by a speed factor, and triggers interrupts.
+*/
+
+typedef struct mmapReplayState {
+    char* file;
+    const char* map;
+    size_t mapsize;
+    double speed;
+    int running;
+    epicsEventId start;
+    unsigned long long count;
+    unsigned long long replayed;
+    unsigned int runs;
+} mmapReplayState;
+
+static void mmapReplayThread(void* arg)
+{
+    regDevice *device = arg;
+    mmapReplayState* replay = device->replay;
+    const mmapCaptureHeader* header = (const mmapCaptureHeader*)replay->map;
+    size_t recordsize = sizeof(mmapCaptureRecord) + ((header->size + 7) & ~7);
+
+    while (1)
+    {
+        const mmapCaptureRecord* record;
+        struct timespec start, next;
+        epicsUInt64 first = 0, delay;
+        mmapIntrInfo *info;
+        unsigned long long i;
+
+        epicsEventMustWait(replay->start);
+        clock_gettime(CLOCK_MONOTONIC, &start);
+        for (i = 0; i < replay->count; i++)
+        {
+            record = (const mmapCaptureRecord*)(replay->map + sizeof(mmapCaptureHeader) + i * recordsize);
+            if (i == 0)
+                first = record->time;
+            delay = (epicsUInt64)((record->time - first) / replay->speed);
+            next.tv_sec = start.tv_sec + delay / 1000000000;
+            next.tv_nsec = start.tv_nsec + delay % 1000000000;
+            if (next.tv_nsec >= 1000000000)
+            {
+                next.tv_sec++;
+                next.tv_nsec -= 1000000000;
+            }
+            while (clock_nanosleep(CLOCK_MONOTONIC, TIMER_ABSTIME, &next, NULL) == EINTR);
+            memcpy((char*)device->localbaseaddress + header->offset, record + 1, header->size);
+            replay->replayed++;
+            for (info = intrInfos; info; info = info->next)
+                if (info->device == device && info->intrlevel == INTR_REPLAY)
+                    mmapInterrupt(info);
+        }
+        replay->runs++;
+        replay->running = 0;
+        if (mmapDebug)
+            printf("mmapReplayThread %s: replayed %llu records from %s\n",
+                device->name, replay->count, replay->file);
+    }
+}
+
+static int mmapStartReplay(regDevice *device, const char* spec)
+{
+    mmapReplayState* replay;
+    const mmapCaptureHeader* header = MAP_FAILED;
+    struct stat sb;
+    char threadname[32];
+    char* file;
+    char* colon;
+    double speed = 1.0;
+    int fd;
+
+    /* file[:speed] */
+    file = strdup(spec);
+    if (!file)
+        return -1;
+    colon = strrchr(file, ':');
+    if (colon)
+    {
+        char* end;
+        speed = strtod(colon+1, &end);
+        if (*end || speed <= 0)
+        {
+            errlogSevPrintf(errlogFatal,
+                "mmapConfigure %s: Invalid replay=%s. Use replay=file[:speed] with speed > 0.\n",
+                device->name, spec);
+            goto fail;
+        }
+        *colon = 0;
+    }
+    fd = open(file, O_RDONLY | O_CLOEXEC);
+    if (fd < 0 || fstat(fd, &sb) != 0)
+    {
+        errlogSevPrintf(errlogFatal,
+            "mmapConfigure %s: Cannot open %s: %s\n",
+            device->name, file, strerror(errno));
+        if (fd >= 0) close(fd);
+        goto fail;
+    }
+    header = mmap(NULL, sb.st_size, PROT_READ, MAP_SHARED, fd, 0);
+    close(fd);
+    if ((size_t)sb.st_size < sizeof(mmapCaptureHeader) || header == MAP_FAILED ||
+        memcmp(header->magic, CAPTURE_MAGIC, 8) != 0)
+    {
+        errlogSevPrintf(errlogFatal,
+            "mmapConfigure %s: %s is not a capture file.\n",
+            device->name, file);
+        goto fail;
+    }
+    if (header->offset + header->size > device->size)
+    {
+        errlogSevPrintf(errlogFatal,
+            "mmapConfigure %s: Captured region 0x%llx:0x%llx exceeds device size 0x%"Z"x.\n",
+            device->name, (unsigned long long)header->offset, (unsigned long long)header->size, device->size);
+        goto fail;
+    }
+    replay = calloc(1, sizeof(mmapReplayState));
+    if (!replay)
+    {
+        errlogSevPrintf(errlogFatal,
+            "mmapConfigure %s: Out of memory for replay.\n",
+            device->name);
+        goto fail;
+    }
+    replay->file = file;
+    replay->map = (const char*)header;
+    replay->mapsize = sb.st_size;
+    replay->speed = speed;
+    /* records of an incomplete file */
+    replay->count = (sb.st_size - sizeof(mmapCaptureHeader)) /
+        (sizeof(mmapCaptureRecord) + ((header->size + 7) & ~7));
+    if (header->count < replay->count)
+        replay->count = header->count;
+    replay->start = epicsEventMustCreate(epicsEventEmpty);
+    device->replay = replay;
+
+    sprintf(threadname, "%.24s-replay", device->name);
+    if (!epicsThreadCreate(threadname, epicsThreadPriorityHigh,
+        epicsThreadGetStackSize(epicsThreadStackSmall),
+        mmapReplayThread, device))
+    {
+        errlogSevPrintf(errlogFatal,
+            "mmapConfigure %s: epicsThreadCreate for replay failed: %s\n",
+            device->name, strerror(errno));
+        device->replay = NULL;
+        epicsEventDestroy(replay->start);
+        free(replay);
+        goto fail;
+    }
+    if (mmapDebug)
+        printf("mmapConfigure %s: replay %llu records of 0x%llx:0x%llx from %s\n",
+            device->name, replay->count, (unsigned long long)header->offset,
+            (unsigned long long)header->size, file);
+    return 0;
+
+fail:
+    if (header != MAP_FAILED)
+        munmap((void*)header, sb.st_size);
+    free(file);
+    return -1;
+}
+
+int mmapReplay(const char* name, double speed)
+{
+    regDevice *device;
+
+    for (device = mmapDevices; device; device = device->next)
+        if (name && strcmp(device->name, name) == 0)
+            break;
+    if (!device || !device->replay)
+    {
+        errlogSevPrintf(errlogMajor,
+            "mmapReplay: %s is not an mmap device configured with replay.\n",
+            name ? name : "(null)");
+        return -1;
+    }
+    if (device->replay->running)
+    {
+        errlogSevPrintf(errlogMajor,
+            "mmapReplay %s: Replay is already running.\n", name);
+        return -1;
+    }
+    if (speed > 0)
+        device->replay->speed = speed;
+    device->replay->running = 1;
+    epicsEventSignal(device->replay->start);
+    return 0;
+}
+#endif /* HAVE_CAPTURE */
+
+/* Interrupts generated by the driver itself (replay, mirror) */
+mmapIntrInfo *mmapConnectSoftInterrupt(const char* user, regDevice *device, int intrlevel)
+{
+    mmapIntrInfo *info;
+
+    info = calloc(sizeof(mmapIntrInfo), 1);
+    if (!info) {
+        errlogSevPrintf(errlogFatal,
+            "mmapConnectSoftInterrupt %s %s: Out of memory.\n",
+            user, device->name);
+        return NULL;
+    }
+    info->device = device;
+    info->intrlevel = intrlevel;
+    info->intrvector = 0;
+    scanIoInit(&info->ioscanpvt);
+    if (!info->ioscanpvt)
+    {
+        errlogSevPrintf(errlogFatal,
+            "mmapConnectSoftInterrupt %s %s: scanIoInit failed: %s\n",
+            user, device->name, strerror(errno));
+        free(info);
+        return NULL;
+    }
+#ifdef HAVE_SNAPSHOT
+    if (device->snapshot)
+        scanIoSetComplete(info->ioscanpvt, mmapSnapshotScanComplete, device);
+#endif /* HAVE_SNAPSHOT */
+    return info;
+}
+
+#ifdef HAVE_MIRROR
+static void mmapMirrorThread(void* arg)
+{
+    regDevice *device = arg;
+    mmapMirror* mirror = device->mirror;
+    mmapIntrInfo *info;
+
+    while (1)
+    {
+        mmapMirrorRefresh(device);
+        if (mirror->scan)
+            for (info = intrInfos; info; info = info->next)
+                if (info->device == device && info->intrlevel == INTR_MIRROR)
+                    mmapInterrupt(info);
+        epicsThreadSleep(mirror->period);
+    }
+}
+
+static int mmapStartMirror(regDevice *device, const char* spec)
+{
+    mmapMirror* mirror;
+    unsigned long offset, size;
+    double period = 0;
+    int scan = 0;
+    char threadname[32];
+    char* end;
+
+    /* offset:size:period[:scan] or offset:size:intr */
+    offset = strtoul(spec, &end, 0);
+    if (*end != ':')
+        goto usage;
+    size = strtoul(end+1, &end, 0);
+    if (*end != ':' || size == 0)
+        goto usage;
+    end++;
+    if (strcasecmp(end, "intr") != 0)
+    {
+        period = strtod(end, &end);
+        if (period <= 0)
+            goto usage;
+        if (strcasecmp(end, ":scan") == 0)
+        {
+            scan = 1;
+            end += 5;
+        }
+        if (*end)
+            goto usage;
+    }
+    if (offset + size > device->size)
+    {
+        errlogSevPrintf(errlogFatal,
+            "mmapConfigure %s: Mirror region 0x%lx:0x%lx exceeds device size 0x%"Z"x.\n",
+            device->name, offset, size, device->size);
+        return -1;
+    }
+    if (period == 0 && device->intrvector < 0)
+    {
+        errlogSevPrintf(errlogFatal,
+            "mmapConfigure %s: Mirror refresh at interrupts needs an interrupt source.\n",
+            device->name);
+        return -1;
+    }
+    mirror = calloc(1, sizeof(mmapMirror));
+    if (!mirror || !(mirror->data = calloc(1, size)) || !(mirror->staging = malloc(size)))
+    {
+        errlogSevPrintf(errlogFatal,
+            "mmapConfigure %s: Out of memory for mirror.\n",
+            device->name);
+        return -1;
+    }
+    mirror->offset = offset;
+    mirror->size = size;
+    mirror->period = period;
+    mirror->scan = scan;
+    mirror->lock = epicsMutexMustCreate();
+    /* use the widest register access that fits the region */
+    for (mirror->dlen = 8; (offset | size) & (mirror->dlen-1); mirror->dlen >>= 1);
+    device->mirror = mirror;
+    mmapMirrorRefresh(device);
+
+    if (period > 0)
+    {
+        if (scan && device->intrvector < 0)
+        {
+            /* interrupts come from the mirror */
+            device->intrvector = 0;
+            device->intrlevel = INTR_MIRROR;
+            device->intrsource = "mirror";
+        }
+        sprintf(threadname, "%.24s-mirror", device->name);
+        if (!epicsThreadCreate(threadname, epicsThreadPriorityMedium,
+            epicsThreadGetStackSize(epicsThreadStackSmall),
+            mmapMirrorThread, device))
+        {
+            errlogSevPrintf(errlogFatal,
+                "mmapConfigure %s: epicsThreadCreate for mirror failed: %s\n",
+                device->name, strerror(errno));
+            device->mirror = NULL;
+            return -1;
+        }
+    }
+    if (mmapDebug)
+        printf("mmapConfigure %s: mirror 0x%lx:0x%lx refreshed %s%g s%s\n",
+            device->name, offset, size, period ? "every " : "at interrupts ",
+            period, scan ? " with I/O Intr" : "");
+    return 0;
+
+usage:
+    errlogSevPrintf(errlogFatal,
+        "mmapConfigure %s: Invalid mirror=%s. Use mirror=offset:size:seconds[:scan] or mirror=offset:size:intr.\n",
+        device->name, spec);
+    return -1;
+}
+
+/* Returns 1 if the read was served from the mirror */
+static int mmapMirrorRead(regDevice *device, size_t offset, unsigned int dlen, size_t nelem,
+    void* pdata)
+{
+    mmapMirror* mirror = device->mirror;
+
+    if (offset < mirror->offset || offset + nelem*dlen > mirror->offset + mirror->size)
+        return 0;
+    epicsMutexMustLock(mirror->lock);
+    regDevCopy(dlen, nelem, mirror->data + offset - mirror->offset, pdata, NULL, 0);
+    mirror->reads++;
+    epicsMutexUnlock(mirror->lock);
+    return 1;
+}
+
+/* Keep the mirror consistent with writes until the next refresh */
+static void mmapMirrorWrite(regDevice *device, size_t offset, unsigned int dlen, size_t nelem,
+    void* pdata, void* pmask)
+{
+    mmapMirror* mirror = device->mirror;
+
+    if (offset < mirror->offset || offset + nelem*dlen > mirror->offset + mirror->size)
+        return;
+    epicsMutexMustLock(mirror->lock);
+    regDevCopy(dlen, nelem, pdata, mirror->data + offset - mirror->offset, pmask, 0);
+    epicsMutexUnlock(mirror->lock);
+}
+#endif /* HAVE_MIRROR */
+
+#ifdef HAVE_UIO
+
+/* File descriptor interrupt sources */
+#define FD_UIO      0
+#define FD_FIFO     1   /* named pipe, writer sends 4 byte count */
+#define FD_SOCKET   2   /* UNIX datagram socket, writer sends 4 byte count */
+#define FD_EVENTFD  3   /* inherited eventfd, 8 byte counter */
+
+void mmapUioInterruptThread(void* arg)
+{
+    mmapIntrInfo *info = arg;
+    regDevice *device = info->device;
+    int fd = info->uiofd;
+    int n;
+    epicsUInt32 intrno = 0;
+    epicsUInt32 reenable = info->fdtype == FD_UIO;
+    epicsUInt32 lastnum = 0;
+    epicsUInt64 events;
+    int running = 0;
+
+    if (reenable && write(fd, &reenable, 4) == -1)
+    {
+        if (mmapDebug)
+            printf("mmapUioInterruptThread %s: %s does not need re-enable.\n",
+                device->name, info->uioname);
+        reenable = 0;
+    }
+    while (1)
+    {
+        if (info->fdtype == FD_EVENTFD)
+        {
+            /* eventfd accumulates events into one counter */
+            n = read(fd, &events, 8);
+            if (n == 8 && events > 1)
+                info->intrmissed += events - 1;
+        }
+        else
+            n = read(fd, &intrno, 4);
+        if (n == -1)
+        {
+            if (errno == EINTR) continue;
+            break;
+        }
+        running = 1;
+        TRACE(TRACE_WAKEUP, device, intrno, n, 0);
+
+        if (n == 4)
+        {
+            if (lastnum && intrno != lastnum+1)
+            {
+                info->intrmissed++;
+            }
+            lastnum = intrno;
+        }
+
+        mmapInterrupt(arg);
+        if (reenable) write(fd, &reenable, 4);
+    }
+    errlogSevPrintf(errlogFatal,
+        "mmapUioInterruptThread %s: Interrupt handling %s working on %s: %s\n",
+        device->name, running ? "stopped" : "not", info->uioname, strerror(errno));
+    close(fd);
+}
+
+/* Names of non-uio file descriptor interrupt sources, index is the intrvector */
+#define MAX_FD_SOURCES 256
+static char* mmapFdSources[MAX_FD_SOURCES];
+
+static int mmapFdSourceId(const char* intrsource)
+{
+    int i;
+
+    for (i = 0; i < MAX_FD_SOURCES && mmapFdSources[i]; i++)
+        if (strcmp(mmapFdSources[i], intrsource) == 0)
+            return i;
+    if (i == MAX_FD_SOURCES)
+        return -1;
+    mmapFdSources[i] = strdup(intrsource);
+    return i;
+}
+
+mmapIntrInfo *mmapConnectFdInterrupt(const char* user, regDevice *device, int id)
+{
+    mmapIntrInfo *info = NULL;
+    char threadname[16];
+    const char *source;
+    struct stat sb;
+    int fdtype;
+    int fd = -1;
+
+    if (id < 0 || id >= MAX_FD_SOURCES || !mmapFdSources[id])
+    {
+        errlogSevPrintf(errlogFatal,
+            "mmapConnectFdInterrupt %s %s: Invalid interrupt source %d.\n",
+            user, device->name, id);
+        return NULL;
+    }
+    source = mmapFdSources[id];
+    if (mmapDebug)
+        printf("mmapConnectFdInterrupt %s %s: source %s\n",
+            user, device->name, source);
+
+    if (strncmp(source, "fd=", 3) == 0)
+    {
+        fdtype = FD_EVENTFD;
+        fd = atoi(source+3);
+        if (fcntl(fd, F_GETFD) == -1)
+        {
+            errlogSevPrintf(errlogFatal,
+                "mmapConnectFdInterrupt %s %s: %s is not an open file descriptor.\n",
+                user, device->name, source);
+            return NULL;
+        }
+    }
+    else if (strncmp(source, "unix:", 5) == 0 || (stat(source, &sb) == 0 && S_ISSOCK(sb.st_mode)))
+    {
+        struct sockaddr_un addr;
+        const char* path = strncmp(source, "unix:", 5) == 0 ? source+5 : source;
+
+        fdtype = FD_SOCKET;
+        if (strlen(path) >= sizeof(addr.sun_path))
+        {
+            errlogSevPrintf(errlogFatal,
+                "mmapConnectFdInterrupt %s %s: Socket path %s too long.\n",
+                user, device->name, path);
+            return NULL;
+        }
+        memset(&addr, 0, sizeof(addr));
+        addr.sun_family = AF_UNIX;
+        strcpy(addr.sun_path, path);
+        fd = socket(AF_UNIX, SOCK_DGRAM | SOCK_CLOEXEC, 0);
+        if (fd >= 0)
+        {
+            /* remove stale socket from previous run */
+            if (stat(path, &sb) == 0 && S_ISSOCK(sb.st_mode))
+                unlink(path);
+            if (bind(fd, (struct sockaddr*)&addr, sizeof(addr)) != 0)
+            {
+                close(fd);
+                fd = -1;
+            }
+        }
+    }
+    else
+    {
+        /* FIFO: open read/write so that it never reports end of file when writers close */
+        fdtype = FD_FIFO;
+        fd = open(source, O_RDWR | O_CLOEXEC);
+    }
+    if (fd < 0)
+    {
+        errlogSevPrintf(errlogFatal,
+            "mmapConnectFdInterrupt %s %s: Cannot open %s: %s\n",
+            user, device->name, source, strerror(errno));
+        return NULL;
+    }
+
+    info = calloc(sizeof(mmapIntrInfo) + strlen(source), 1);
+    if (!info) {
+        errlogSevPrintf(errlogFatal,
+            "mmapConnectFdInterrupt %s %s: Out of memory.\n",
+            user, device->name);
+        goto fail;
+    }
+    info->device = device;
+    info->intrlevel = INTR_FD;
+    info->intrvector = id;
+    info->fdtype = fdtype;
+    info->uiofd = fd;
+    strcpy(info->uioname, source);
+
+    scanIoInit(&info->ioscanpvt);
+    if (!info->ioscanpvt) {
+        errlogSevPrintf(errlogFatal,
+            "mmapConnectFdInterrupt %s %s: scanIoInit failed: %s\n",
+            user, device->name, strerror(errno));
+        goto fail;
+    }
+#ifdef HAVE_SNAPSHOT
+    if (device->snapshot)
+        scanIoSetComplete(info->ioscanpvt, mmapSnapshotScanComplete, device);
+#endif /* HAVE_SNAPSHOT */
+
+    sprintf(threadname, "Ifd%d", id);
+    if (mmapDebug)
+        printf("mmapConnectFdInterrupt %s %s: Starting interrupt thread %s for %s.\n",
+            user, device->name, threadname, source);
+
+    if (!epicsThreadCreate(threadname, epicsThreadPriorityMax,
+        epicsThreadGetStackSize(epicsThreadStackSmall),
+        mmapUioInterruptThread, info))
+    {
+        errlogSevPrintf(errlogFatal,
+            "mmapConnectFdInterrupt %s %s: epicsThreadCreate failed: %s\n",
+            user, device->name, strerror(errno));
+        goto fail;
+    }
+    return info;
+fail:
+    free(info);
+    if (fdtype != FD_EVENTFD)
+        close(fd);
+    return NULL;
+}
+
+/* Inventory of uio devices from glob, done once
+   and done again only if a uio number is not found
+*/
+static glob_t mmapUioDevices;
+static int mmapUioDevicesValid = 0;
+
+static void mmapReadUioDevices(void)
+{
+    if (mmapUioDevicesValid)
+        globfree(&mmapUioDevices);
+    mmapUioDevicesValid = glob("/dev/uio*", 0, NULL, &mmapUioDevices) == 0;
+}
+
+static const char* mmapFindUioDevice(int uionum)
+{
+    int reread = 0;
+    size_t i;
+
+    if (!mmapUioDevicesValid)
+    {
+        mmapReadUioDevices();
+        reread = 1;
+    }
+    while (1)
+    {
+        for (i = 0; mmapUioDevicesValid && i < mmapUioDevices.gl_pathc; i++)
+        {
+            /* match uio devices with the number at the end, like /dev/uio0 or /dev/uioXYZ0 */
+            const char* path = mmapUioDevices.gl_pathv[i];
+            const char* p = path + strlen(path);
+            while (p > path && p[-1] >= '0' && p[-1] <= '9') p--;
+            if (*p && atoi(p) == uionum)
+                return path;
+        }
+        if (reread) break;
+        mmapReadUioDevices();
+        reread = 1;
+    }
+    return NULL;
+}
+
+mmapIntrInfo *mmapConnectUioInterrupt(const char* user, regDevice *device, int uionum)
+{
+#define THREADNAMESTRING "Iuio"
+
+    mmapIntrInfo *info = NULL;
+    char threadname[sizeof(THREADNAMESTRING)+sizeof(uionum)*2+sizeof(uionum)/2];
+    const char *uioname;
+    int fd;
+
+    if (mmapDebug)
+        printf("mmapConnectUioInterrupt %s %s: uionum = %d\n",
+            user, device->name, uionum);
+
+    uioname = mmapFindUioDevice(uionum);
+    if (!uioname) {
+        errlogSevPrintf(errlogFatal,
+            "mmapConnectUioInterrupt %s %s: No uio number %u found.\n",
+            user, device->name, uionum);
+        goto fail;
+    }
+    if (mmapDebug)
+        printf("mmapConnectUioInterrupt %s %s: Found %s\n",
+            user, device->name, uioname);
+    fd = open(uioname, O_RDWR | O_CLOEXEC);
+    if (fd < 0)
+    {
+        fd = open(uioname, O_RDONLY | O_CLOEXEC);
+        if (fd < 0) {
+            errlogSevPrintf(errlogFatal,
+                "mmapConnectUioInterrupt %s %s: Cannot open %s: %s\n",
+                user, device->name, uioname, strerror(errno));
+            goto fail;
+        }
+        if (mmapDebug)
+            printf("mmapConnectUioInterrupt %s %s: %s is readonly.\n",
+                user, device->name, uioname);
+    }
+
+    info = calloc(sizeof(mmapIntrInfo) + strlen(uioname), 1);
+    if (!info) {
+        errlogSevPrintf(errlogFatal,
+            "mmapConnectUioInterrupt %s %s: Out of memory.\n",
+            user, device->name);
+        goto fail;
+    }
+    info->device = device;
+    info->intrlevel = INTR_UIO;
+    info->intrvector = uionum;
+    info->uiofd = fd;
+    strcpy(info->uioname, uioname);
+
+    scanIoInit(&info->ioscanpvt);
+    if (!info->ioscanpvt) {
+        errlogSevPrintf(errlogFatal,
+            "mmapConnectUioInterrupt %s %s: scanIoInit failed: %s\n",
+            user, device->name, strerror(errno));
+        goto fail;
+    }
+#ifdef HAVE_SNAPSHOT
+    if (device->snapshot)
+        scanIoSetComplete(info->ioscanpvt, mmapSnapshotScanComplete, device);
+#endif /* HAVE_SNAPSHOT */
+
+    sprintf(threadname, THREADNAMESTRING "%u", uionum);
+    if (mmapDebug)
+        printf("mmapConnectUioInterrupt %s %s: Starting interrupt thread %s for %s.\n",
+            user, device->name, threadname, uioname);
+
+    if (!epicsThreadCreate(threadname, epicsThreadPriorityMax,
+        epicsThreadGetStackSize(epicsThreadStackSmall),
+        mmapUioInterruptThread, info))
+    {
+        errlogSevPrintf(errlogFatal,
+            "mmapConnectUioInterrupt %s %s: epicsThreadCreate failed: %s\n",
+            user, device->name, strerror(errno));
+        goto fail;
+    }
+    return info;
+fail:
+    free(info);
+    return NULL;
+}
+#endif /* HAVE_UIO */
+
+mmapIntrInfo *mmapConnectVmeInterrupt(const char* user, regDevice *device, int intrvector, int intrlevel)
+{
+    mmapIntrInfo *info;
+
+    if (intrvector > 0xff)
+    {
+        intrlevel = intrvector >> 8;
+        intrvector &= 0xff;
+    }
+
+    if (mmapDebug)
+        printf("mmapConnectVmeInterrupt %s %s: intrvector=%#x intrlevel = %d\n",
+            user, device->name, intrvector, intrlevel);
+
+    /* VME interrupt handlers may run in interrupt context where they must not lock or copy regions */
+#ifdef HAVE_MIRROR
+    if (device->mirror && device->mirror->period == 0)
+    {
+        errlogSevPrintf(errlogFatal,
+            "mmapConnectVmeInterrupt %s %s: Mirror refresh on interrupt needs a uio, fd or replay interrupt source.\n",
+            user, device->name);
+        return NULL;
+    }
+#endif /* HAVE_MIRROR */
+#ifdef HAVE_PUBLISH
+    if (device->publisher)
+    {
+        errlogSevPrintf(errlogFatal,
+            "mmapConnectVmeInterrupt %s %s: Publication on interrupt needs a uio, fd or replay interrupt source.\n",
+            user, device->name);
+        return NULL;
+    }
+#endif /* HAVE_PUBLISH */
+
+    if (!intrlevel)
+    {
+        errlogSevPrintf(errlogMajor,
+            "mmapConnectVmeInterrupt %s %s: Warning: No VME interrupt level given. Interrupts for vector %#x may not be enabled.\n",
+            user, device->name, intrvector);
+    }
+    else if (intrlevel < 1 || intrlevel > 7)
+    {
+        errlogSevPrintf(errlogFatal,
+            "mmapConnectVmeInterrupt %s %s: Invalid VME interrupt level %i.\n",
+            user, device->name, intrlevel);
+        return NULL;
+    }
+    if (intrvector < 1 || intrlevel > 255)
+    {
+        errlogSevPrintf(errlogFatal,
+            "mmapConnectVmeInterrupt %s %s: Invalid VME interrupt vector %#x.\n",
+            user, device->name, intrlevel);
+        return NULL;
+    }
+
+    info = calloc(sizeof(mmapIntrInfo), 1);
+    if (!info) {
+        errlogSevPrintf(errlogFatal,
+            "mmapConnectUioInterrupt %s %s: Out of memory.\n",
+            user, device->name);
+        return NULL;
+    }
+
+    info->device = device;
+    info->intrlevel = intrlevel;
+    info->intrvector = intrvector;
+    scanIoInit(&info->ioscanpvt);
+
+    if (!info->ioscanpvt)
+    {
+        errlogSevPrintf(errlogFatal,
+            "mmapConnectVmeInterrupt %s %s: scanIoInit failed: %s\n",
+            user, device->name, strerror(errno));
+        free(info);
+        return NULL;
+    }
+#ifdef HAVE_SNAPSHOT
+    if (device->snapshot)
+        scanIoSetComplete(info->ioscanpvt, mmapSnapshotScanComplete, device);
+#endif /* HAVE_SNAPSHOT */
+
+    if (devConnectInterrupt(intVME, intrvector, mmapInterrupt, info) != 0)
+    {
+        errlogSevPrintf(errlogFatal,
+            "mmapConnectVmeInterrupt %s %s: Cannot connect to VME interrupt vector %#x.\n",
+            user, device->name, intrvector);
+        free(info);
+        return NULL;
+    }
+
+    if (intrlevel && devEnableInterruptLevel(intVME, intrlevel) != 0)
+    {
+        errlogSevPrintf(errlogMajor,
+            "mmapConnectVmeInterrupt %s %s: Warning: Cannot enable VME interrupt level %d.\n",
+            user, device->name, intrlevel);
+    }
+    return info;
+}
+
+#ifdef HAVE_ATOMIC
+/* Masked write to memory that other threads or processes may modify too:
+   Each element changes from its current to its final value in one atomic
+   operation, so that concurrent writers of other bits are never lost.
+   Only bits to clear: fetch_and, only bits to set: fetch_or, both: CAS loop.
+   Returns 0 (and writes nothing) if the elements are not naturally aligned.
+*/
+#define MMAP_ATOMIC_MASKED(type) \
+    { \
+        volatile type* d = dst; \
+        type m, v, old, new; \
+        memcpy(&m, pmask, sizeof(type)); \
+        for (i = 0; i < nelem; i++) \
+        { \
+            memcpy(&v, (const char*)src + i*sizeof(type), sizeof(type)); \
+            if (m == (type)~(type)0) \
+                __atomic_store_n(&d[i], v, __ATOMIC_RELAXED); \
+            else if ((v & m) == 0) \
+                __atomic_fetch_and(&d[i], (type)~m, __ATOMIC_RELAXED); \
+            else if ((v & m) == m) \
+                __atomic_fetch_or(&d[i], m, __ATOMIC_RELAXED); \
+            else \
+            { \
+                old = __atomic_load_n(&d[i], __ATOMIC_RELAXED); \
+                do new = (old & ~m) | (v & m); \
+                while (!__atomic_compare_exchange_n(&d[i], &old, new, 1, __ATOMIC_RELAXED, __ATOMIC_RELAXED)); \
+            } \
+        } \
+        return 1; \
+    }
+
+static int mmapAtomicMaskedWrite(unsigned int dlen, size_t nelem, const void* src, volatile void* dst, const void* pmask)
+{
+    size_t i;
+
+    if ((size_t)dst & (dlen-1))
+        return 0;
+    switch (dlen)
+    {
+        case 1: MMAP_ATOMIC_MASKED(epicsUInt8)
+        case 2: MMAP_ATOMIC_MASKED(epicsUInt16)
+        case 4: MMAP_ATOMIC_MASKED(epicsUInt32)
+#ifdef __GCC_HAVE_SYNC_COMPARE_AND_SWAP_8
+        case 8: MMAP_ATOMIC_MASKED(epicsUInt64)
+#endif
+    }
+    return 0;
+}
+#endif /* HAVE_ATOMIC */
+
+#ifdef HAVE_WRITEBEHIND
+/* Write-behind: Small writes are put into a lock-free queue (multiple
+   producers) and a flusher thread writes them to the device in address
+   order with one barrier per batch.
+   Writes to identical ranges are merged. Overlapping writes end a batch.
+*/
+
+#define WB_DATA_SIZE 32
+#define WB_BATCH_SIZE 64
+#define WB_DEFAULT_SIZE 256
+
+typedef struct mmapWriteEntry {
+    size_t seq;
+    size_t offset;
+    unsigned int dlen;
+    unsigned int nelem;
+    int masked;
+    union {
+        epicsUInt64 align;
+        char bytes[8];
+    } mask;
+    union {
+        epicsUInt64 align;
+        char bytes[WB_DATA_SIZE];
+    } data;
+} mmapWriteEntry;
+
+typedef struct mmapWriteQueue {
+    size_t size;                    /* power of 2 */
+    size_t tail;                    /* next entry to fill, shared by writers */
+    char pad[64];                   /* keep tail and head on different cache lines */
+    size_t head;                    /* next entry to flush, protected by flushLock */
+    size_t done;                    /* entries before this are written to the device */
+    int pending;
+    int haveHeld;
+    mmapWriteEntry held;            /* overlapping entry postponed to the next batch */
+    epicsEventId wakeup;
+    epicsMutexId flushLock;
+    unsigned long long flushed;
+    unsigned long long merged;
+    unsigned long long batches;
+    unsigned long long overflows;
+    mmapWriteEntry batch[WB_BATCH_SIZE];
+    mmapWriteEntry entries[1];
+} mmapWriteQueue;
+
+/* All queued writes have reached the device */
+static int mmapWriteQueueDone(mmapWriteQueue* wb)
+{
+    return __atomic_load_n(&wb->tail, __ATOMIC_ACQUIRE) == __atomic_load_n(&wb->done, __ATOMIC_ACQUIRE);
+}
+
+static int mmapWriteQueuePut(mmapWriteQueue* wb, size_t offset, unsigned int dlen, size_t nelem, const void* pdata, const void* pmask)
+{
+    size_t pos = __atomic_load_n(&wb->tail, __ATOMIC_RELAXED);
+    mmapWriteEntry* entry;
+
+    while (1)
+    {
+        size_t seq;
+        entry = &wb->entries[pos & (wb->size-1)];
+        seq = __atomic_load_n(&entry->seq, __ATOMIC_ACQUIRE);
+        if (seq == pos)
+        {
+            if (__atomic_compare_exchange_n(&wb->tail, &pos, pos+1, 1, __ATOMIC_RELAXED, __ATOMIC_RELAXED))
+                break;
+        }
+        else if ((ptrdiff_t)(seq - pos) < 0)
+            return -1; /* full */
+        else
+            pos = __atomic_load_n(&wb->tail, __ATOMIC_RELAXED);
+    }
+    entry->offset = offset;
+    entry->dlen = dlen;
+    entry->nelem = nelem;
+    entry->masked = pmask != NULL;
+    if (pmask) memcpy(entry->mask.bytes, pmask, dlen);
+    memcpy(entry->data.bytes, pdata, nelem*dlen);
+    __atomic_store_n(&entry->seq, pos+1, __ATOMIC_RELEASE);
+
+    /* wake up the flusher only if it is not already about to run */
+    if (!__atomic_exchange_n(&wb->pending, 1, __ATOMIC_SEQ_CST))
+        epicsEventSignal(wb->wakeup);
+    return 0;
+}
+
+static int mmapWriteQueueGet(mmapWriteQueue* wb, mmapWriteEntry* entry)
+{
+    mmapWriteEntry* next;
+
+    if (wb->haveHeld)
+    {
+        *entry = wb->held;
+        wb->haveHeld = 0;
+        return 1;
+    }
+    next = &wb->entries[wb->head & (wb->size-1)];
+    if (__atomic_load_n(&next->seq, __ATOMIC_ACQUIRE) != wb->head+1)
+        return 0; /* empty */
+    *entry = *next;
+    __atomic_store_n(&next->seq, wb->head + wb->size, __ATOMIC_RELEASE);
+    wb->head++;
+    return 1;
+}
+
+/* Caller must hold flushLock.
+   Entries before upto which other writers have reserved but not yet filled
+   are waited for, so that the caller's own queued writes are all written.
+*/
+static void mmapWriteQueueFlush(regDevice *device, size_t upto)
+{
+    mmapWriteQueue* wb = device->writeQueue;
+    mmapWriteEntry* batch = wb->batch;
+    size_t n, i, j;
+
+    do {
+        n = 0;
+        while (n < WB_BATCH_SIZE && mmapWriteQueueGet(wb, &batch[n]))
+        {
+            mmapWriteEntry* new = &batch[n];
+            size_t newend = new->offset + new->nelem * new->dlen;
+            mmapWriteEntry* same = NULL;
+            int overlap = 0;
+
+            for (i = 0; i < n; i++)
+            {
+                mmapWriteEntry* old = &batch[i];
+                if (old->offset >= newend || new->offset >= old->offset + old->nelem * old->dlen)
+                    continue;
+                if (old->offset == new->offset && old->dlen == new->dlen && old->nelem == new->nelem)
+                    same = old;
+                else
+                    overlap = 1;
+            }
+            if (overlap)
+            {
+                /* cannot reorder partially overlapping writes: postpone */
+                wb->held = *new;
+                wb->haveHeld = 1;
+                break;
+            }
+            if (same)
+            {
+                if (new->masked)
+                {
+                    for (j = 0; j < new->nelem * new->dlen; j++)
+                    {
+                        char m = new->mask.bytes[j % new->dlen];
+                        same->data.bytes[j] = (same->data.bytes[j] & ~m) | (new->data.bytes[j] & m);
+                    }
+                    if (same->masked)
+                        for (j = 0; j < new->dlen; j++)
+                            same->mask.bytes[j] |= new->mask.bytes[j];
+                }
+                else
+                {
+                    *same = *new;
+                }
+                wb->merged++;
+                continue;
+            }
+            n++;
+        }
+        if (n == 0)
+        {
+            if ((ptrdiff_t)(upto - wb->head) <= 0)
+                break;
+            epicsThreadSleep(0);
+            continue;
+        }
+
+        /* sort by address (batches are short) */
+        for (i = 1; i < n; i++)
+        {
+            mmapWriteEntry tmp = batch[i];
+            for (j = i; j > 0 && batch[j-1].offset > tmp.offset; j--)
+                batch[j] = batch[j-1];
+            batch[j] = tmp;
+        }
+        for (i = 0; i < n; i++)
+        {
+            if (batch[i].masked)
+                CACHE_INVALIDATE(device, batch[i].offset, batch[i].nelem * batch[i].dlen);
+            if (!batch[i].masked || !SHARED_MEMORY(device) ||
+                !mmapAtomicMaskedWrite(batch[i].dlen, batch[i].nelem, batch[i].data.bytes,
+                    device->localbaseaddress+batch[i].offset, batch[i].mask.bytes))
+                regDevCopy(batch[i].dlen, batch[i].nelem, batch[i].data.bytes,
+                    device->localbaseaddress+batch[i].offset,
+                    batch[i].masked ? batch[i].mask.bytes : NULL, 0);
+            CACHE_FLUSH(device, batch[i].offset, batch[i].nelem * batch[i].dlen);
+        }
+        SYNC
+        /* entries taken from the queue are not yet written before this point */
+        __atomic_store_n(&wb->done, wb->head - wb->haveHeld, __ATOMIC_RELEASE);
+        wb->flushed += n;
+        wb->batches++;
+        TRACE(TRACE_FLUSH, device, batch[0].offset, n, TRACE_MAP);
+    } while (1);
+}
+
+int mmapFlushDevice(regDevice *device)
+{
+    mmapWriteQueue* wb;
+    size_t upto;
+
+    if (!device || device->magic != MAGIC)
+        return -1;
+    wb = device->writeQueue;
+    if (!wb)
+        return 0;
+    upto = __atomic_load_n(&wb->tail, __ATOMIC_ACQUIRE);
+    epicsMutexMustLock(wb->flushLock);
+    mmapWriteQueueFlush(device, upto);
+    epicsMutexUnlock(wb->flushLock);
+    return 0;
+}
+
+static void mmapWriteBehindThread(void* arg)
+{
+    regDevice *device = arg;
+    mmapWriteQueue* wb = device->writeQueue;
+
+    while (1)
+    {
+        epicsEventMustWait(wb->wakeup);
+        __atomic_store_n(&wb->pending, 0, __ATOMIC_SEQ_CST);
+        epicsMutexMustLock(wb->flushLock);
+        mmapWriteQueueFlush(device, wb->head);
+        epicsMutexUnlock(wb->flushLock);
+    }
+}
+
+static int mmapStartWriteBehind(regDevice *device, size_t size)
+{
+    mmapWriteQueue* wb;
+    size_t i;
+
+    /* round up to power of 2 */
+    for (i = 1; i < size; i <<= 1);
+    size = i;
+
+    wb = calloc(1, sizeof(mmapWriteQueue) + (size-1) * sizeof(mmapWriteEntry));
+    if (!wb)
+    {
+        errlogSevPrintf(errlogFatal,
+            "mmapConfigure %s: Out of memory for write-behind queue.\n",
+            device->name);
+        return -1;
+    }
+    wb->size = size;
+    for (i = 0; i < size; i++)
+        wb->entries[i].seq = i;
+    wb->wakeup = epicsEventMustCreate(epicsEventEmpty);
+    wb->flushLock = epicsMutexMustCreate();
+    device->writeQueue = wb;
+    if (!epicsThreadCreate(device->name, epicsThreadPriorityHigh,
+        epicsThreadGetStackSize(epicsThreadStackSmall),
+        mmapWriteBehindThread, device))
+    {
+        errlogSevPrintf(errlogFatal,
+            "mmapConfigure %s: epicsThreadCreate for write-behind failed: %s\n",
+            device->name, strerror(errno));
+        device->writeQueue = NULL;
+        return -1;
+    }
+    if (mmapDebug)
+        printf("mmapConfigure %s: write-behind queue with %"Z"u entries\n",
+            device->name, size);
+    return 0;
+}
+#endif /* HAVE_WRITEBEHIND */
+
+int mmapFlush(const char* name)
+{
+#ifdef HAVE_WRITEBEHIND
+    regDevice *device;
+
+    for (device = mmapDevices; device; device = device->next)
+    {
+        if (name && name[0] && strcmp(name, device->name) != 0)
+            continue;
+        mmapFlushDevice(device);
+    }
+#endif /* HAVE_WRITEBEHIND */
+    return 0;
+}
+
+/* Masked copy to ordinary memory (not to a bus with side effects):
+   The mask of one element is repeated into a 32 byte pattern, so that
+   elements of any size 1, 2, 4 or 8 can be processed in vector blocks.
+*/
+#ifdef HAVE_AVX2
+__attribute__((target("avx2")))
+static size_t mmapMaskedCopyAvx2(size_t len, const char* src, char* dst, const char* pattern)
+{
+    __m256i m = _mm256_loadu_si256((const __m256i*)pattern);
+    size_t i;
+
+    for (i = 0; i + 32 <= len; i += 32)
+    {
+        __m256i s = _mm256_loadu_si256((const __m256i*)(src + i));
+        __m256i d = _mm256_loadu_si256((const __m256i*)(dst + i));
+        _mm256_storeu_si256((__m256i*)(dst + i),
+            _mm256_or_si256(_mm256_and_si256(m, s), _mm256_andnot_si256(m, d)));
+    }
+    return i;
+}
+#endif /* HAVE_AVX2 */
+
+static void mmapMaskedCopy(unsigned int dlen, size_t nelem, const void* src, void* dst, const void* pmask)
+{
+    const char* s = src;
+    char* d = dst;
+    size_t len = nelem*dlen;
+    size_t i;
+    union {
+        epicsUInt64 q[4];
+        char b[32];
+    } m;
+
+    for (i = 0; i < 32; i++)
+        m.b[i] = ((const char*)pmask)[i % dlen];
+    i = 0;
+#ifdef HAVE_AVX2
+    {
+        static int haveAvx2 = -1;
+        if (haveAvx2 < 0)
+        {
+            __builtin_cpu_init();
+            haveAvx2 = __builtin_cpu_supports("avx2");
+        }
+        if (haveAvx2)
+            i = mmapMaskedCopyAvx2(len, s, d, m.b);
+    }
+#endif /* HAVE_AVX2 */
+#ifdef HAVE_NEON
+    {
+        uint8x16_t mv = vld1q_u8((const uint8_t*)m.b);
+        for (; i + 16 <= len; i += 16)
+            vst1q_u8((uint8_t*)(d + i),
+                vbslq_u8(mv, vld1q_u8((const uint8_t*)(s + i)), vld1q_u8((const uint8_t*)(d + i))));
+    }
+#endif /* HAVE_NEON */
+    for (; i + 8 <= len; i += 8)
+    {
+        epicsUInt64 sv, dv;
+        memcpy(&sv, s + i, 8);
+        memcpy(&dv, d + i, 8);
+        dv = (dv & ~m.q[0]) | (sv & m.q[0]);
+        memcpy(d + i, &dv, 8);
+    }
+    for (; i < len; i++)
+        d[i] = (d[i] & ~m.b[i % 32]) | (s[i] & m.b[i % 32]);
+}
+
+static void mmapSwap(
+    regDevice *device,
+    void* pdata,
+    unsigned int dlen,
+    size_t nelem)
+{
+    if (device->flags & SWAP_DWORD_PAIRS)
+    {
+        epicsUInt64* p = pdata;
+        size_t i;
+        for (i = 0; i < nelem*dlen/8; i++)
+            p[i] = p[i] >> 32 | p[i] << 32;
+    }
+    if (device->flags & SWAP_WORD_PAIRS)
+    {
+        epicsUInt32* p = pdata;
+        size_t i;
+        for (i = 0; i < nelem*dlen/4; i++)
+            p[i] = p[i] >> 16 | p[i] << 16;
+    }
+    if (device->flags & SWAP_BYTE_PAIRS)
+    {
+        epicsUInt16* p = pdata;
+        size_t i;
+        for (i = 0; i < nelem*dlen/2; i++)
+            p[i] = p[i] >> 8 | p[i] << 8;
+    }
+}
+
+#ifdef HAVE_FILEIO
+/* File I/O for address spaces that cannot be mapped.
+   Asynchronous transfers use io_uring if available,
+   everything else uses pread/pwrite.
+*/
+
+#ifdef HAVE_URING
+#define URING_DEFAULT_ENTRIES 64
+
+typedef struct mmapUringRequest {
+    struct mmapUringRequest* next;
+    regDevice *device;
+    regDevTransferComplete callback;
+    const char* user;
+    unsigned int dlen;
+    size_t nelem;
+    int isRead;
+    struct iovec iov;
+} mmapUringRequest;
+
+typedef struct mmapUring {
+    regDevice *device;
+    int fd;
+    unsigned int entries;
+    unsigned int *sqHead, *sqTail, *sqMask, *sqArray;
+    unsigned int *cqHead, *cqTail, *cqMask;
+    struct io_uring_sqe* sqes;
+    struct io_uring_cqe* cqes;
+    unsigned int unsubmitted;
+    epicsMutexId sqLock;
+    epicsEventId submit;
+    epicsEventId drained;
+    int draining;
+    int stop;
+    mmapUringRequest* freeRequests;
+    unsigned int writesInFlight;
+    unsigned long long queued;
+    unsigned long long submitted;
+    unsigned long long completed;
+    unsigned long long batches;
+    unsigned long long errors;
+    mmapUringRequest requests[1];
+} mmapUring;
+
+static int mmapUringTransfer(
+    regDevice *device,
+    int isRead,
+    size_t offset,
+    unsigned int dlen,
+    size_t nelem,
+    void* pdata,
+    regDevTransferComplete callback,
+    const char* user)
+{
+    mmapUring* ring = device->uring;
+    mmapUringRequest* req;
+    struct io_uring_sqe* sqe;
+    unsigned int tail, index;
+
+    epicsMutexMustLock(ring->sqLock);
+    tail = *ring->sqTail;
+    req = ring->freeRequests;
+    if (!req || tail - __atomic_load_n(ring->sqHead, __ATOMIC_ACQUIRE) >= ring->entries)
+    {
+        /* ring full: let caller do a synchronous transfer */
+        epicsMutexUnlock(ring->sqLock);
+        return -1;
+    }
+    ring->freeRequests = req->next;
+    req->device = device;
+    req->callback = callback;
+    req->user = user;
+    req->dlen = dlen;
+    req->nelem = nelem;
+    req->isRead = isRead;
+    req->iov.iov_base = pdata;
+    req->iov.iov_len = nelem*dlen;
+
+    index = tail & *ring->sqMask;
+    sqe = &ring->sqes[index];
+    memset(sqe, 0, sizeof(*sqe));
+    sqe->opcode = isRead ? IORING_OP_READV : IORING_OP_WRITEV;
+    /* io_uring may run requests in any order: a write starts after all
+       earlier requests, a read after all earlier writes */
+    if (!isRead || ring->writesInFlight)
+        sqe->flags = IOSQE_IO_DRAIN;
+    if (!isRead)
+        ring->writesInFlight++;
+    sqe->fd = device->fd;
+    sqe->off = device->baseaddress + offset;
+    sqe->addr = (uintptr_t) &req->iov;
+    sqe->len = 1;
+    sqe->user_data = (uintptr_t) req;
+    ring->sqArray[index] = index;
+    __atomic_store_n(ring->sqTail, tail+1, __ATOMIC_RELEASE);
+    ring->queued++;
+
+    /* the submit thread submits all requests queued until it runs in one system call */
+    if (ring->unsubmitted++ == 0)
+        epicsEventSignal(ring->submit);
+    epicsMutexUnlock(ring->sqLock);
+    return ASYNC_COMPLETION;
+}
+
+/* Wait until all requests queued so far are completed,
+   e.g. before a synchronous read-modify-write of the same file.
+*/
+static void mmapUringDrain(mmapUring* ring)
+{
+    unsigned long long target;
+
+    epicsMutexMustLock(ring->sqLock);
+    target = ring->queued;
+    ring->draining++;
+    while (ring->completed < target)
+    {
+        epicsMutexUnlock(ring->sqLock);
+        epicsEventWaitWithTimeout(ring->drained, 0.1);
+        epicsMutexMustLock(ring->sqLock);
+    }
+    ring->draining--;
+    epicsMutexUnlock(ring->sqLock);
+}
+
+static void mmapUringSubmitThread(void* arg)
+{
+    mmapUring* ring = arg;
+    regDevice *device = ring->device;
+    unsigned int n;
+    int submitted;
+
+    while (1)
+    {
+        epicsEventMustWait(ring->submit);
+        if (ring->stop)
+        {
+            /* setup failed after this thread was started */
+            epicsEventSignal(ring->drained);
+            return;
+        }
+        epicsMutexMustLock(ring->sqLock);
+        n = ring->unsubmitted;
+        epicsMutexUnlock(ring->sqLock);
+        if (!n) continue;
+        submitted = syscall(__NR_io_uring_enter, ring->fd, n, 0, 0, NULL, 0);
+        if (submitted < 0)
+        {
+            if (errno != EINTR && errno != EAGAIN && errno != EBUSY)
+            {
+                errlogSevPrintf(errlogFatal,
+                    "mmapUringSubmitThread %s: io_uring_enter failed: %s\n",
+                    device->name, strerror(errno));
+                epicsThreadSleep(1.0);
+            }
+            submitted = 0;
+        }
+        epicsMutexMustLock(ring->sqLock);
+        ring->unsubmitted -= submitted;
+        ring->submitted += submitted;
+        ring->batches++;
+        if (ring->unsubmitted)
+            epicsEventSignal(ring->submit);
+        epicsMutexUnlock(ring->sqLock);
+    }
+}
+
+static void mmapUringCompletionThread(void* arg)
+{
+    mmapUring* ring = arg;
+    regDevice *device = ring->device;
+    unsigned int head, tail;
+
+    while (1)
+    {
+        head = *ring->cqHead;
+        tail = __atomic_load_n(ring->cqTail, __ATOMIC_ACQUIRE);
+        if (head == tail)
+        {
+            if (syscall(__NR_io_uring_enter, ring->fd, 0, 1, IORING_ENTER_GETEVENTS, NULL, 0) < 0 && errno != EINTR)
+            {
+                errlogSevPrintf(errlogFatal,
+                    "mmapUringCompletionThread %s: io_uring_enter failed: %s\n",
+                    device->name, strerror(errno));
+                epicsThreadSleep(1.0);
+            }
+            continue;
+        }
+        while (head != tail)
+        {
+            struct io_uring_cqe* cqe = &ring->cqes[head & *ring->cqMask];
+            mmapUringRequest* req = (mmapUringRequest*)(uintptr_t) cqe->user_data;
+            int res = cqe->res;
+            regDevTransferComplete callback = req->callback;
+            const char* user = req->user;
+            int status = 0;
+
+            head++;
+            __atomic_store_n(ring->cqHead, head, __ATOMIC_RELEASE);
+
+            if (res != (int)req->iov.iov_len)
+            {
+                errlogSevPrintf(errlogMajor,
+                    "%s %s %s: %s\n",
+                    req->isRead ? "mmapRead" : "mmapWrite", user, device->name,
+                    res < 0 ? strerror(-res) : "Short transfer");
+                ring->errors++;
+                status = -1;
+            }
+            else if (req->isRead)
+                mmapSwap(device, req->iov.iov_base, req->dlen, req->nelem);
+
+            /* recycle request before callback which may start the next transfer */
+            epicsMutexMustLock(ring->sqLock);
+            req->next = ring->freeRequests;
+            ring->freeRequests = req;
+            if (!req->isRead)
+                ring->writesInFlight--;
+            ring->completed++;
+            if (ring->draining)
+                epicsEventSignal(ring->drained);
+            epicsMutexUnlock(ring->sqLock);
+            callback(user, status);
+        }
+    }
+}
+
+static int mmapStartUring(regDevice *device, unsigned int entries)
+{
+    struct io_uring_params params;
+    mmapUring* ring = NULL;
+    char* sq = MAP_FAILED;
+    char* cq = MAP_FAILED;
+    size_t sqsize, cqsize;
+    char threadname[32];
+    unsigned int i;
+    int fd;
+
+    memset(&params, 0, sizeof(params));
+    fd = syscall(__NR_io_uring_setup, entries, &params);
+    if (fd < 0)
+    {
+        if (mmapDebug)
+            printf("mmapConfigure %s: io_uring not available: %s\n",
+                device->name, strerror(errno));
+        return -1;
+    }
+    sqsize = params.sq_off.array + params.sq_entries * sizeof(unsigned int);
+    cqsize = params.cq_off.cqes + params.cq_entries * sizeof(struct io_uring_cqe);
+    if ((params.features & IORING_FEAT_SINGLE_MMAP) && cqsize > sqsize)
+        sqsize = cqsize;
+    sq = mmap(NULL, sqsize, PROT_READ|PROT_WRITE, MAP_SHARED|MAP_POPULATE, fd, IORING_OFF_SQ_RING);
+    if (sq == MAP_FAILED)
+        goto fail;
+    if (params.features & IORING_FEAT_SINGLE_MMAP)
+        cq = sq;
+    else
+    {
+        cq = mmap(NULL, cqsize, PROT_READ|PROT_WRITE, MAP_SHARED|MAP_POPULATE, fd, IORING_OFF_CQ_RING);
+        if (cq == MAP_FAILED)
+            goto fail;
+    }
+    ring = calloc(1, sizeof(mmapUring) + (params.sq_entries-1) * sizeof(mmapUringRequest));
+    if (!ring)
+        goto fail;
+    ring->sqes = mmap(NULL, params.sq_entries * sizeof(struct io_uring_sqe),
+        PROT_READ|PROT_WRITE, MAP_SHARED|MAP_POPULATE, fd, IORING_OFF_SQES);
+    if (ring->sqes == MAP_FAILED)
+        goto fail;
+    ring->device = device;
+    ring->fd = fd;
+    ring->entries = params.sq_entries;
+    ring->sqHead = (unsigned int*)(sq + params.sq_off.head);
+    ring->sqTail = (unsigned int*)(sq + params.sq_off.tail);
+    ring->sqMask = (unsigned int*)(sq + params.sq_off.ring_mask);
+    ring->sqArray = (unsigned int*)(sq + params.sq_off.array);
+    ring->cqHead = (unsigned int*)(cq + params.cq_off.head);
+    ring->cqTail = (unsigned int*)(cq + params.cq_off.tail);
+    ring->cqMask = (unsigned int*)(cq + params.cq_off.ring_mask);
+    ring->cqes = (struct io_uring_cqe*)(cq + params.cq_off.cqes);
+    for (i = 0; i < params.sq_entries; i++)
+    {
+        ring->requests[i].next = ring->freeRequests;
+        ring->freeRequests = &ring->requests[i];
+    }
+    ring->sqLock = epicsMutexMustCreate();
+    ring->submit = epicsEventMustCreate(epicsEventEmpty);
+    ring->drained = epicsEventMustCreate(epicsEventEmpty);
+
+    /* the threads get the ring as argument, the device sees it only when both run */
+    sprintf(threadname, "%.26s-sq", device->name);
+    if (!epicsThreadCreate(threadname, epicsThreadPriorityHigh,
+        epicsThreadGetStackSize(epicsThreadStackSmall),
+        mmapUringSubmitThread, ring))
+        goto threadfail;
+    sprintf(threadname, "%.26s-cq", device->name);
+    if (!epicsThreadCreate(threadname, epicsThreadPriorityHigh,
+        epicsThreadGetStackSize(epicsThreadStackMedium),
+        mmapUringCompletionThread, ring))
+    {
+        /* stop the submit thread before the ring goes away */
+        ring->stop = 1;
+        epicsEventSignal(ring->submit);
+        epicsEventMustWait(ring->drained);
+        goto threadfail;
+    }
+    device->uring = ring;
+    if (mmapDebug)
+        printf("mmapConfigure %s: io_uring with %u entries\n",
+            device->name, ring->entries);
+    return 0;
+
+threadfail:
+    errlogSevPrintf(errlogMajor,
+        "mmapConfigure %s: epicsThreadCreate for io_uring failed: %s\n",
+        device->name, strerror(errno));
+    epicsEventDestroy(ring->drained);
+    epicsEventDestroy(ring->submit);
+    epicsMutexDestroy(ring->sqLock);
+fail:
+    if (mmapDebug)
+        printf("mmapConfigure %s: io_uring setup failed: %s\n",
+            device->name, strerror(errno));
+    if (ring)
+    {
+        if (ring->sqes != MAP_FAILED)
+            munmap(ring->sqes, params.sq_entries * sizeof(struct io_uring_sqe));
+        free(ring);
+    }
+    if (cq != MAP_FAILED && cq != sq)
+        munmap(cq, cqsize);
+    if (sq != MAP_FAILED)
+        munmap(sq, sqsize);
+    close(fd);
+    return -1;
+}
+#endif /* HAVE_URING */
+
+static int mmapFileTransfer(
+    regDevice *device,
+    int isRead,
+    size_t offset,
+    unsigned int dlen,
+    size_t nelem,
+    void* pdata,
+    void* pmask,
+    regDevTransferComplete callback,
+    const char* user)
+{
+    off_t pos = device->baseaddress + offset;
+    size_t len = nelem*dlen;
+    size_t done = 0;
+    ssize_t n;
+    char* buffer = pdata;
+
+#ifdef HAVE_URING
+    if (device->uring && callback && !pmask)
+    {
+        if (mmapUringTransfer(device, isRead, offset, dlen, nelem, pdata, callback, user) == ASYNC_COMPLETION)
+            return ASYNC_COMPLETION;
+    }
+    /* synchronous transfers (also if the ring is full) must not
+       overtake queued requests or read before queued writes are done */
+    if (device->uring)
+        mmapUringDrain(device->uring);
+#endif /* HAVE_URING */
+    if (pmask)
+    {
+        /* read-modify-write */
+        epicsMutexMustLock(device->fileLock);
+        buffer = malloc(len);
+        if (!buffer || pread(device->fd, buffer, len, pos) != (ssize_t)len)
+        {
+            errlogSevPrintf(errlogMajor,
+                "mmapWrite %s %s: Cannot read for masked write: %s\n",
+                user, device->name, buffer ? strerror(errno) : "Out of memory");
+            epicsMutexUnlock(device->fileLock);
+            free(buffer);
+            return -1;
+        }
+        if (dlen == 1 || dlen == 2 || dlen == 4 || dlen == 8)
+            mmapMaskedCopy(dlen, nelem, pdata, buffer, pmask);
+        else
+            regDevCopy(dlen, nelem, pdata, buffer, pmask, 0);
+    }
+    while (done < len)
+    {
+        n = isRead ? pread(device->fd, buffer + done, len - done, pos + done)
+                   : pwrite(device->fd, buffer + done, len - done, pos + done);
+        if (n < 0 && errno == EINTR) continue;
+        if (n <= 0) break;
+        done += n;
+    }
+    if (pmask)
+    {
+        epicsMutexUnlock(device->fileLock);
+        free(buffer);
+    }
+    if (done < len)
+    {
+        errlogSevPrintf(errlogMajor,
+            "%s %s %s: %s\n",
+            isRead ? "mmapRead" : "mmapWrite", user, device->name,
+            n < 0 ? strerror(errno) : "Short transfer");
+        return -1;
+    }
+    if (isRead)
+        mmapSwap(device, pdata, dlen, nelem);
+    return 0;
+}
+#endif /* HAVE_FILEIO */
+
+#ifdef HAVE_SHADOW
+/* Shadow copy of a register region: masked writes are computed on the
+   shadow and written to the device without reading the registers first.
+   Optionally, reads are served from the shadow.
+   The shadow starts with zeros unless it is initialized from the registers
+   with an explicit access width.
+*/
+typedef struct mmapShadow {
+    size_t offset;
+    size_t size;
+    int readback;
+    epicsMutexId lock;
+    unsigned long long writes;
+    unsigned long long reads;
+    char* data;
+} mmapShadow;
+
+static int mmapStartShadow(regDevice *device, const char* spec)
+{
+    mmapShadow* shadow;
+    unsigned long offset, size;
+    unsigned long init = 0;
+    int readback = 0;
+    char* end;
+
+    offset = strtoul(spec, &end, 0);
+    if (*end != ':')
+        goto usage;
+    size = strtoul(end+1, &end, 0);
+    while (*end == ':')
+    {
+        if (strncasecmp(end+1, "read", 4) == 0 && (end[5] == ':' || end[5] == 0))
+        {
+            readback = 1;
+            end += 5;
+        }
+        else if (strncasecmp(end+1, "init", 4) == 0)
+        {
+            /* registers may only allow accesses of their own width */
+            init = 4;
+            end += 5;
+            if (*end == '=')
+                init = strtoul(end+1, &end, 0);
+            if (init != 1 && init != 2 && init != 4 && init != 8)
+                goto usage;
+        }
+        else
+            goto usage;
+    }
+    if (*end || size == 0 || (init && (offset % init || size % init)))
+        goto usage;
+    if (offset + size > device->size)
+    {
+        errlogSevPrintf(errlogFatal,
+            "mmapConfigure %s: Shadow region 0x%lx:0x%lx exceeds device size 0x%"Z"x.\n",
+            device->name, offset, size, device->size);
+        return -1;
+    }
+    shadow = calloc(1, sizeof(mmapShadow));
+    if (!shadow || !(shadow->data = calloc(1, size)))
+    {
+        errlogSevPrintf(errlogFatal,
+            "mmapConfigure %s: Out of memory for shadow registers.\n",
+            device->name);
+        free(shadow);
+        return -1;
+    }
+    shadow->offset = offset;
+    shadow->size = size;
+    shadow->readback = readback;
+    shadow->lock = epicsMutexMustCreate();
+    if (init)
+    {
+        /* start with what is in the registers now */
+        CACHE_INVALIDATE(device, offset, size);
+        regDevCopy(init, size/init, device->localbaseaddress+offset, shadow->data, NULL, 0);
+    }
+    device->shadow = shadow;
+    if (mmapDebug)
+        printf("mmapConfigure %s: shadow 0x%lx:0x%lx%s%s\n",
+            device->name, offset, size, readback ? " with readback" : "",
+            init ? " initialized from registers" : "");
+    return 0;
+
+usage:
+    errlogSevPrintf(errlogFatal,
+        "mmapConfigure %s: Invalid shadow=%s. Use shadow=offset:size[:read][:init[=width]].\n",
+        device->name, spec);
+    return -1;
+}
+
+/* Returns 1 if the whole transfer was done using the shadow */
+static int mmapShadowWrite(regDevice *device, size_t offset, unsigned int dlen, size_t nelem,
+    void* pdata, void* pmask)
+{
+    mmapShadow* shadow = device->shadow;
+    size_t len = nelem*dlen;
+    char* shadowdata;
+
+    if (offset >= shadow->offset + shadow->size || offset + len <= shadow->offset)
+        return 0;
+#ifdef HAVE_WRITEBEHIND
+    /* do not overtake queued writes to the same registers */
+    if (device->writeQueue && !mmapWriteQueueDone(device->writeQueue))
+        mmapFlushDevice(device);
+#endif /* HAVE_WRITEBEHIND */
+    if (offset < shadow->offset || offset + len > shadow->offset + shadow->size)
+    {
+        /* partial overlap: write to device and copy the written bits of the overlapping part into the shadow */
+        size_t start = offset > shadow->offset ? offset : shadow->offset;
+        size_t end = offset + len < shadow->offset + shadow->size ? offset + len : shadow->offset + shadow->size;
+        size_t i;
+
+        epicsMutexMustLock(shadow->lock);
+        if (pmask)
+            CACHE_INVALIDATE(device, offset, len);
+        regDevCopy(dlen, nelem, pdata, device->localbaseaddress+offset, pmask, 0);
+        CACHE_FLUSH(device, offset, len);
+        SYNC
+        for (i = start; i < end; i++)
+        {
+            char m = pmask ? ((char*)pmask)[(i - offset) % dlen] : (char)0xff;
+            char* d = shadow->data + i - shadow->offset;
+            *d = (*d & ~m) | (((char*)pdata)[i - offset] & m);
+        }
+        epicsMutexUnlock(shadow->lock);
+        return 1;
+    }
+    shadowdata = shadow->data + offset - shadow->offset;
+    epicsMutexMustLock(shadow->lock);
+    if (pmask && (dlen == 1 || dlen == 2 || dlen == 4 || dlen == 8))
+        mmapMaskedCopy(dlen, nelem, pdata, shadowdata, pmask);
+    else
+        regDevCopy(dlen, nelem, pdata, shadowdata, pmask, 0);
+    /* plain write, no read-modify-write on the bus */
+    regDevCopy(dlen, nelem, shadowdata, device->localbaseaddress+offset, NULL, 0);
+    CACHE_FLUSH(device, offset, len);
+    SYNC
+    shadow->writes++;
+    epicsMutexUnlock(shadow->lock);
+    return 1;
+}
 
-    if (devConnectInterrupt(intVME, intrvector, mmapInterrupt, info) != 0)
+/* Returns 1 if the read was served from the shadow */
+static int mmapShadowRead(regDevice *device, size_t offset, unsigned int dlen, size_t nelem,
+    void* pdata)
+{
+    mmapShadow* shadow = device->shadow;
+
+    if (!shadow->readback || offset < shadow->offset ||
+        offset + nelem*dlen > shadow->offset + shadow->size)
+        return 0;
+    epicsMutexMustLock(shadow->lock);
+    regDevCopy(dlen, nelem, shadow->data + offset - shadow->offset, pdata, NULL, 0);
+    shadow->reads++;
+    epicsMutexUnlock(shadow->lock);
+    return 1;
+}
+#endif /* HAVE_SHADOW */
+
+#ifdef HAVE_PARALLEL
+/* Large transfers are split into chunks which are copied (and swapped)
+   by a pool of worker threads together with the calling thread.
+   Only one large transfer runs in parallel at a time, others are done
+   by the calling thread alone.
+*/
+#define PARALLEL_DEFAULT_SIZE 0x400000 /* 4 MiB */
+#define PARALLEL_MAX_THREADS 64
+#define PARALLEL_MIN_CHUNK 0x40000
+#define PARALLEL_CHUNK_ALIGN 4096
+
+typedef struct mmapCopyJob {
+    regDevice* device;
+    volatile char* src;
+    volatile char* dst;
+    unsigned int dlen;
+    int swap;
+    size_t nelem;
+    size_t chunkelem;
+    size_t nchunks;
+    size_t next;
+} mmapCopyJob;
+
+static struct {
+    int nthreads;
+    int running;
+    epicsMutexId lock;
+    epicsEventId done;
+    epicsEventId wakeup[PARALLEL_MAX_THREADS];
+    int cpus[PARALLEL_MAX_THREADS];
+    mmapCopyJob job;
+    unsigned long long jobs;
+    unsigned long long busy;
+} mmapCopyPool;
+
+static void mmapCopyChunks(mmapCopyJob* job)
+{
+    size_t i, first, n;
+
+    while ((i = __atomic_fetch_add(&job->next, 1, __ATOMIC_RELAXED)) < job->nchunks)
     {
-        errlogSevPrintf(errlogFatal,
-            "mmapConnectVmeInterrupt %s %s: Cannot connect to VME interrupt vector %#x.\n",
-            user, device->name, intrvector);
-        free(info);
-        return NULL;
+        first = i * job->chunkelem;
+        n = job->nelem - first < job->chunkelem ? job->nelem - first : job->chunkelem;
+        regDevCopy(job->dlen, n, job->src + first*job->dlen, job->dst + first*job->dlen, NULL, 0);
+        if (job->swap)
+            mmapSwap(job->device, (char*)job->dst + first*job->dlen, job->dlen, n);
     }
+}
 
-    if (intrlevel && devEnableInterruptLevel(intVME, intrlevel) != 0)
+static void mmapCopyWorker(void* arg)
+{
+    int id = (int)(size_t)arg;
+
+#if defined(__linux__) && defined(CPU_SET)
+    if (mmapCopyPool.cpus[id] >= 0)
+    {
+        cpu_set_t set;
+        CPU_ZERO(&set);
+        CPU_SET(mmapCopyPool.cpus[id], &set);
+        if (sched_setaffinity(0, sizeof(set), &set) != 0 && mmapDebug)
+            printf("mmapCopyWorker %d: Cannot bind to CPU %d: %s\n",
+                id, mmapCopyPool.cpus[id], strerror(errno));
+    }
+#endif
+    while (1)
+    {
+        epicsEventMustWait(mmapCopyPool.wakeup[id]);
+        mmapCopyChunks(&mmapCopyPool.job);
+        if (__atomic_sub_fetch(&mmapCopyPool.running, 1, __ATOMIC_ACQ_REL) == 0)
+            epicsEventSignal(mmapCopyPool.done);
+    }
+}
+
+#if defined(__linux__) && defined(CPU_SET)
+/* Order the CPUs we may run on round robin over the NUMA nodes,
+   so that a few workers already use the memory bandwidth of all nodes.
+*/
+static int mmapCopyCpus(int* cpus, int max)
+{
+    static short node[CPU_SETSIZE], rank[CPU_SETSIZE];
+    short count[64] = {0};
+    cpu_set_t allowed;
+    char filename[64];
+    int i, n = 0, r, maxrank = 0;
+
+    if (sched_getaffinity(0, sizeof(allowed), &allowed) != 0)
+        return 0;
+    for (i = 0; i < CPU_SETSIZE; i++)
+        node[i] = -1;
+    for (r = 0; r < 64; r++)
+    {
+        FILE* file;
+        int first, last;
+        char sep;
+
+        sprintf(filename, "/sys/devices/system/node/node%d/cpulist", r);
+        file = fopen(filename, "r");
+        if (!file) continue;
+        while (fscanf(file, "%d", &first) == 1)
+        {
+            last = first;
+            sep = fgetc(file);
+            if (sep == '-')
+            {
+                if (fscanf(file, "%d", &last) != 1) break;
+                sep = fgetc(file);
+            }
+            for (i = first; i <= last && i < CPU_SETSIZE; i++)
+                node[i] = r;
+            if (sep != ',') break;
+        }
+        fclose(file);
+    }
+    for (i = 0; i < CPU_SETSIZE; i++)
+    {
+        if (!CPU_ISSET(i, &allowed)) continue;
+        r = node[i] < 0 ? 0 : node[i];
+        rank[i] = count[r]++;
+        if (rank[i] > maxrank) maxrank = rank[i];
+    }
+    for (r = 0; r <= maxrank && n < max; r++)
+        for (i = 0; i < CPU_SETSIZE && n < max; i++)
+            if (CPU_ISSET(i, &allowed) && rank[i] == r)
+                cpus[n++] = i;
+    return n;
+}
+#endif
+
+static int mmapStartCopyPool(int nthreads)
+{
+    char threadname[16];
+    int cpus[PARALLEL_MAX_THREADS];
+    int i, ncpus = 0;
+
+    if (mmapCopyPool.nthreads)
+        return 0;
+#if defined(__linux__) && defined(CPU_SET)
+    ncpus = mmapCopyCpus(cpus, PARALLEL_MAX_THREADS);
+#endif
+    if (nthreads <= 0)
+        nthreads = ncpus > 1 ? ncpus - 1 : 1; /* the caller copies too */
+    if (nthreads > PARALLEL_MAX_THREADS)
+        nthreads = PARALLEL_MAX_THREADS;
+    /* leave the first CPU for the calling thread */
+    for (i = 0; i < PARALLEL_MAX_THREADS; i++)
+        mmapCopyPool.cpus[i] = ncpus > 1 ? cpus[1 + i % (ncpus - 1)] : -1;
+    mmapCopyPool.lock = epicsMutexMustCreate();
+    mmapCopyPool.done = epicsEventMustCreate(epicsEventEmpty);
+    for (i = 0; i < nthreads; i++)
+    {
+        mmapCopyPool.wakeup[i] = epicsEventMustCreate(epicsEventEmpty);
+        sprintf(threadname, "mmapCopy%d", i);
+        if (!epicsThreadCreate(threadname, epicsThreadPriorityHigh,
+            epicsThreadGetStackSize(epicsThreadStackSmall),
+            mmapCopyWorker, (void*)(size_t)i))
+        {
+            errlogSevPrintf(errlogMajor,
+                "mmapStartCopyPool: epicsThreadCreate failed: %s\n",
+                strerror(errno));
+            break;
+        }
+    }
+    mmapCopyPool.nthreads = i;
+    if (mmapDebug)
+        printf("mmapStartCopyPool: %d copy threads\n", i);
+    return i ? 0 : -1;
+}
+
+/* Returns 0 if done, -1 if the pool is busy */
+static int mmapParallelCopy(regDevice* device, volatile char* src, volatile char* dst,
+    unsigned int dlen, size_t nelem, int swap)
+{
+    mmapCopyJob* job = &mmapCopyPool.job;
+    size_t chunksize;
+    int i, nworkers;
+
+    if (epicsMutexTryLock(mmapCopyPool.lock) != epicsMutexLockOK)
+    {
+        mmapCopyPool.busy++;
+        return -1;
+    }
+    /* some chunks per thread to balance the load */
+    chunksize = nelem * dlen / (4 * (mmapCopyPool.nthreads + 1));
+    if (chunksize < PARALLEL_MIN_CHUNK)
+        chunksize = PARALLEL_MIN_CHUNK;
+    chunksize &= ~(size_t)(PARALLEL_CHUNK_ALIGN-1);
+    job->device = device;
+    job->src = src;
+    job->dst = dst;
+    job->dlen = dlen;
+    job->swap = swap;
+    job->nelem = nelem;
+    job->chunkelem = chunksize / dlen;
+    job->nchunks = (nelem + job->chunkelem - 1) / job->chunkelem;
+    job->next = 0;
+    nworkers = job->nchunks - 1 < (size_t)mmapCopyPool.nthreads ? (int)job->nchunks - 1 : mmapCopyPool.nthreads;
+    mmapCopyPool.running = nworkers;
+    for (i = 0; i < nworkers; i++)
+        epicsEventSignal(mmapCopyPool.wakeup[i]);
+    mmapCopyChunks(job);
+    if (nworkers)
+        epicsEventMustWait(mmapCopyPool.done);
+    mmapCopyPool.jobs++;
+    epicsMutexUnlock(mmapCopyPool.lock);
+    return 0;
+}
+
+static int mmapStartParallel(regDevice *device, const char* spec)
+{
+    unsigned long size = PARALLEL_DEFAULT_SIZE;
+    int nthreads = 0;
+    char* end = (char*)spec;
+
+    if (spec)
+    {
+        size = strtoul(spec, &end, 0);
+        if (*end == ':')
+            nthreads = strtol(end+1, &end, 0);
+        if (*end || size < PARALLEL_MIN_CHUNK)
+        {
+            errlogSevPrintf(errlogFatal,
+                "mmapConfigure %s: Invalid parallel=%s. Use parallel[=minsize[:threads]] with minsize >= 0x%x.\n",
+                device->name, spec, PARALLEL_MIN_CHUNK);
+            return -1;
+        }
+    }
+    if (mmapStartCopyPool(nthreads) != 0)
+        return -1;
+    device->parallelSize = size;
+    return 0;
+}
+#endif /* HAVE_PARALLEL */
+
+#ifdef HAVE_CHUNK
+/* Chunked transfers: Large transfers of records with PRIO LOW or MEDIUM
+   are split into chunks. Between chunks they give way to transfers of
+   records with higher priority on the same device, so that bulk arrays
+   do not delay fast control records.
+   regDev serializes the calls for one device. Thus, asynchronous transfers
+   (with a callback) are handed to a worker thread which copies one chunk
+   at a time of the highest priority transfer queued, while the caller
+   returns and other records can access the device.
+   Synchronous and masked transfers are copied in the calling thread.
+   Each chunk is copied under copyLock, so that no other transfer runs
+   in the middle of a chunk.
+*/
+#define CHUNK_PRIORITIES 3
+#define CHUNK_DEFAULT_SIZE 0x10000
+
+typedef struct mmapChunkJob {
+    struct mmapChunkJob* next;
+    int read;
+    size_t offset;
+    unsigned int dlen;
+    size_t nelem;
+    size_t done;
+    char* pdata;
+    regDevTransferComplete callback;
+    const char* user;
+} mmapChunkJob;
+
+typedef struct mmapChunkQueue {
+    epicsMutexId lock;
+    epicsMutexId copyLock;
+    epicsEventId work;
+    mmapChunkJob* head[CHUNK_PRIORITIES];
+    mmapChunkJob* tail[CHUNK_PRIORITIES];
+    unsigned long long jobs;
+    unsigned long long preempted;
+} mmapChunkQueue;
+
+static int mmapChunkHigherPending(regDevice *device, int prio)
+{
+    int p;
+
+    for (p = prio + 1; p < CHUNK_PRIORITIES; p++)
+        if (__atomic_load_n(&device->chunkPending[p], __ATOMIC_ACQUIRE))
+            return 1;
+    return 0;
+}
+
+static void mmapChunkWait(regDevice *device, int prio)
+{
+    while (mmapChunkHigherPending(device, prio))
+    {
+        __atomic_add_fetch(&device->chunkYields, 1, __ATOMIC_RELAXED);
+        epicsEventWaitWithTimeout(device->chunkDone, 0.001);
+    }
+}
+
+static void mmapChunkCopy(regDevice *device, int read, size_t offset, unsigned int dlen, size_t n,
+    char* pdata, void* pmask)
+{
+    volatile char* mem = device->localbaseaddress + offset;
+
+    if (read)
+        regDevCopy(dlen, n, mem, pdata, NULL, 0);
+    else if (pmask && (device->flags & MEMORY_DEVICE) && (dlen == 1 || dlen == 2 || dlen == 4 || dlen == 8))
+    {
+        if (!SHARED_MEMORY(device) || !mmapAtomicMaskedWrite(dlen, n, pdata, mem, pmask))
+            mmapMaskedCopy(dlen, n, pdata, (char*)mem, pmask);
+    }
+    else
+        regDevCopy(dlen, n, pdata, mem, pmask, 0);
+}
+
+static void mmapChunkThread(void* arg)
+{
+    regDevice *device = arg;
+    mmapChunkQueue* queue = device->chunkQueue;
+    mmapChunkJob* job;
+    mmapChunkJob* last = NULL;
+    size_t n;
+    int prio;
+
+    while (1)
+    {
+        epicsMutexMustLock(queue->lock);
+        for (prio = CHUNK_PRIORITIES-1; prio >= 0; prio--)
+            if (queue->head[prio]) break;
+        if (prio < 0)
+        {
+            epicsMutexUnlock(queue->lock);
+            epicsEventMustWait(queue->work);
+            continue;
+        }
+        job = queue->head[prio];
+        epicsMutexUnlock(queue->lock);
+
+        if (last && last != job)
+            queue->preempted++; /* a higher priority transfer overtakes an unfinished one */
+        last = job;
+        mmapChunkWait(device, prio);
+        n = device->chunkSize / job->dlen ? device->chunkSize / job->dlen : 1;
+        if (n > job->nelem - job->done)
+            n = job->nelem - job->done;
+        epicsMutexMustLock(queue->copyLock);
+        mmapChunkCopy(device, job->read, job->offset + job->done*job->dlen, job->dlen, n,
+            job->pdata + job->done*job->dlen, NULL);
+        epicsMutexUnlock(queue->copyLock);
+        job->done += n;
+        if (job->done < job->nelem)
+            continue;
+
+        epicsMutexMustLock(queue->lock);
+        queue->head[prio] = job->next;
+        if (!job->next)
+            queue->tail[prio] = NULL;
+        epicsMutexUnlock(queue->lock);
+        last = NULL;
+        if (job->read)
+            mmapSwap(device, job->pdata, job->dlen, job->nelem);
+        else
+        {
+            CACHE_FLUSH(device, job->offset, job->nelem*job->dlen);
+            SYNC
+        }
+        TRACE(job->read ? TRACE_READ : TRACE_WRITE, device, job->offset, job->nelem*job->dlen, TRACE_CHUNK);
+        job->callback(job->user, 0);
+        free(job);
+    }
+}
+
+static int mmapChunkQueueTransfer(regDevice *device, int read, size_t offset, unsigned int dlen, size_t nelem,
+    void* pdata, int prio, regDevTransferComplete callback, const char* user)
+{
+    mmapChunkQueue* queue = device->chunkQueue;
+    mmapChunkJob* job;
+
+    job = calloc(1, sizeof(mmapChunkJob));
+    if (!job)
+        return -1; /* caller copies synchronously */
+    job->read = read;
+    job->offset = offset;
+    job->dlen = dlen;
+    job->nelem = nelem;
+    job->pdata = pdata;
+    job->callback = callback;
+    job->user = user;
+    epicsMutexMustLock(queue->lock);
+    if (queue->tail[prio])
+        queue->tail[prio]->next = job;
+    else
+        queue->head[prio] = job;
+    queue->tail[prio] = job;
+    queue->jobs++;
+    epicsMutexUnlock(queue->lock);
+    epicsEventSignal(queue->work);
+    return ASYNC_COMPLETION;
+}
+
+static int mmapChunkTransfer(regDevice *device, int read, size_t offset, unsigned int dlen, size_t nelem,
+    void* pdata, void* pmask, int prio, regDevTransferComplete callback, const char* user)
+{
+    mmapChunkQueue* queue = device->chunkQueue;
+    size_t n, i;
+
+    if (prio < 0 || prio >= CHUNK_PRIORITIES)
+        prio = 0;
+    if (prio == CHUNK_PRIORITIES-1 || nelem*dlen <= device->chunkSize)
+        n = nelem;
+    else
+    {
+        n = device->chunkSize / dlen ? device->chunkSize / dlen : 1;
+        /* masked writes are read-modify-write and must not run concurrently with other transfers */
+        if (callback && !pmask && queue && mmapChunkQueueTransfer(device, read, offset, dlen, nelem,
+                pdata, prio, callback, user) == ASYNC_COMPLETION)
+            return ASYNC_COMPLETION;
+    }
+    __atomic_add_fetch(&device->chunkPending[prio], 1, __ATOMIC_ACQ_REL);
+    if (!read && pmask)
+        CACHE_INVALIDATE(device, offset, nelem*dlen);
+    for (i = 0; i < nelem; i += n)
+    {
+        if (n > nelem - i)
+            n = nelem - i;
+        if (i)
+            mmapChunkWait(device, prio);
+        if (queue)
+            epicsMutexMustLock(queue->copyLock);
+        mmapChunkCopy(device, read, offset + i*dlen, dlen, n, (char*)pdata + i*dlen, pmask);
+        if (queue)
+            epicsMutexUnlock(queue->copyLock);
+    }
+    if (read)
+        mmapSwap(device, pdata, dlen, nelem);
+    else
+    {
+        CACHE_FLUSH(device, offset, nelem*dlen);
+        SYNC
+    }
+    if (__atomic_sub_fetch(&device->chunkPending[prio], 1, __ATOMIC_ACQ_REL) == 0 && prio > 0)
+        epicsEventSignal(device->chunkDone);
+    TRACE(read ? TRACE_READ : TRACE_WRITE, device, offset, nelem*dlen,
+        n < nelem ? TRACE_CHUNK : read ? TRACE_MAP : pmask ? TRACE_MASKED : TRACE_MAP);
+    return 0;
+}
+
+static int mmapStartChunks(regDevice *device, const char* spec)
+{
+    unsigned long size = CHUNK_DEFAULT_SIZE;
+    mmapChunkQueue* queue;
+    char threadname[32];
+    char* end;
+
+    if (spec)
+    {
+        size = strtoul(spec, &end, 0);
+        if (*end || size == 0)
+        {
+            errlogSevPrintf(errlogFatal,
+                "mmapConfigure %s: Invalid chunk=%s. Use chunk[=size].\n",
+                device->name, spec);
+            return -1;
+        }
+    }
+    queue = calloc(1, sizeof(mmapChunkQueue));
+    if (!queue)
+    {
+        errlogSevPrintf(errlogFatal,
+            "mmapConfigure %s: Out of memory for chunked transfers.\n",
+            device->name);
+        return -1;
+    }
+    queue->lock = epicsMutexMustCreate();
+    queue->copyLock = epicsMutexMustCreate();
+    queue->work = epicsEventMustCreate(epicsEventEmpty);
+    device->chunkQueue = queue;
+    device->chunkDone = epicsEventMustCreate(epicsEventEmpty);
+    device->chunkSize = size;
+    sprintf(threadname, "%.24s-chunk", device->name);
+    if (!epicsThreadCreate(threadname, epicsThreadPriorityMedium,
+        epicsThreadGetStackSize(epicsThreadStackSmall),
+        mmapChunkThread, device))
     {
+        /* without worker, all transfers are synchronous */
         errlogSevPrintf(errlogMajor,
-            "mmapConnectVmeInterrupt %s %s: Warning: Cannot enable VME interrupt level %d.\n",
-            user, device->name, intrlevel);
+            "mmapConfigure %s: epicsThreadCreate for chunked transfers failed: %s\n",
+            device->name, strerror(errno));
+        device->chunkQueue = NULL;
+        epicsEventDestroy(queue->work);
+        epicsMutexDestroy(queue->copyLock);
+        epicsMutexDestroy(queue->lock);
+        free(queue);
     }
-    return info;
+    return 0;
+}
+#endif /* HAVE_CHUNK */
+
+#ifdef HAVE_MMAP
+/* Memory of a mapped region which is actually resident */
+static size_t mmapResidentSize(volatile char* base, size_t size)
+{
+    static unsigned char vec[1024];
+    size_t pagesize = sysconf(_SC_PAGE_SIZE);
+    size_t chunk = sizeof(vec) * pagesize;
+    size_t offset, len, i, resident = 0;
+    char* start = (char*)((size_t)base & ~(pagesize-1));
+
+    size += (char*)base - start;
+    for (offset = 0; offset < size; offset += chunk)
+    {
+        len = size - offset < chunk ? size - offset : chunk;
+        if (mincore(start + offset, len, vec) != 0)
+            return 0;
+        for (i = 0; i < (len + pagesize - 1) / pagesize; i++)
+            if (vec[i] & 1) resident += pagesize;
+    }
+    return resident < size ? resident : size;
 }
+#endif /* HAVE_MMAP */
 
 void mmapReport(
     regDevice *device,
@@ -385,21 +4082,83 @@ void mmapReport(
         if (device->localbaseaddress)
             printf("mmap %s:0x%x @%p",
                 device->addrspace, device->baseaddress, device->localbaseaddress);
+#ifdef HAVE_FILEIO
+        else if (device->flags & FILE_DEVICE)
+            printf("mmap %s:0x%x (file I/O)",
+                device->addrspace, device->baseaddress);
+#endif /* HAVE_FILEIO */
         else
             printf("mmap %s (no map)", device->addrspace);
 
         if (device->intrvector >= 0)
             printf(" intr=%s", device->intrsource);
+        if (device->shards > 1)
+        {
+            printf(" shards=%u", device->shards);
+            if (device->shardSize)
+                printf(":0x%"Z"x", device->shardSize);
+        }
         if (device->flags & ALLOW_DMA)
             printf(" dma");
         if (device->flags & READONLY_DEVICE)
             printf(" ro");
+        if (device->flags & MEMORY_DEVICE)
+            printf(" mem");
+        if (device->flags & CACHED_DEVICE)
+            printf(" cached");
+        if (device->flags & UNCACHED_DEVICE)
+            printf(" uncached");
+#ifdef HAVE_MMAP
+        if (device->localbaseaddress && strcmp(device->addrspace, "sim") == 0)
+            printf(" resident=%"Z"uk/%"Z"uk",
+                mmapResidentSize(device->localbaseaddress, device->size) >> 10,
+                device->size >> 10);
+#endif /* HAVE_MMAP */
         if (device->flags & SWAP_BYTE_PAIRS)
             printf(" sb");
         if (device->flags & SWAP_WORD_PAIRS)
             printf(" sw");
         if (device->flags & SWAP_DWORD_PAIRS)
             printf(" sd");
+#ifdef HAVE_PERSIST
+        if (device->persist)
+            printf(" persist=%s", device->persist);
+#endif /* HAVE_PERSIST */
+#ifdef HAVE_MEMFD
+        if (device->memfd >= 0)
+            printf(" memfd=/proc/%d/fd/%d", (int)getpid(), device->memfd);
+        if (device->memfdSocket)
+            printf(" socket=%s (%llu clients)", device->memfdSocket, device->memfdClients);
+#endif /* HAVE_MEMFD */
+#ifdef HAVE_WRITEBEHIND
+        if (device->writeQueue)
+            printf(" wb=%"Z"u", device->writeQueue->size);
+#endif /* HAVE_WRITEBEHIND */
+#ifdef HAVE_PARALLEL
+        if (device->parallelSize)
+            printf(" parallel>=0x%"Z"x", device->parallelSize);
+#endif /* HAVE_PARALLEL */
+#ifdef HAVE_CHUNK
+        if (device->chunkSize)
+            printf(" chunk=0x%"Z"x", device->chunkSize);
+#endif /* HAVE_CHUNK */
+#ifdef HAVE_MIRROR
+        if (device->mirror)
+            printf(" mirror=0x%"Z"x:0x%"Z"x", device->mirror->offset, device->mirror->size);
+#endif /* HAVE_MIRROR */
+#ifdef HAVE_EXPORT
+        if (device->export)
+            printf(" export=%s", device->export->path);
+#endif /* HAVE_EXPORT */
+#ifdef HAVE_PUBLISH
+        if (device->publisher)
+            printf(" publish=0x%"Z"x:0x%"Z"x", device->publisher->offset, device->publisher->size);
+#endif /* HAVE_PUBLISH */
+#ifdef HAVE_SHADOW
+        if (device->shadow)
+            printf(" shadow=0x%"Z"x:0x%"Z"x%s", device->shadow->offset, device->shadow->size,
+                device->shadow->readback ? ":read" : "");
+#endif /* HAVE_SHADOW */
         printf("\n");
         if (level > 0)
         {
@@ -409,7 +4168,12 @@ void mmapReport(
                 if (info->device == device)
                 {
 #ifdef HAVE_UIO
-                    if (info->intrlevel == INTR_UIO)
+                    if (info->intrlevel == INTR_REPLAY || info->intrlevel == INTR_MIRROR)
+                        printf("    intr %s count: %llu\n",
+                            info->intrlevel == INTR_REPLAY ? "replay" : "mirror",
+                            info->intrcount);
+                    else
+                    if (info->intrlevel == INTR_UIO || info->intrlevel == INTR_FD)
                         printf("    intr %d (%s) count: %llu, missed: %llu\n",
                             info->intrvector, info->uioname,
                             info->intrcount, info->intrmissed);
@@ -418,8 +4182,114 @@ void mmapReport(
                     printf("    intr %d level %d count: %llu\n",
                             info->intrvector, info->intrlevel,
                             info->intrcount);
+                    if (device->intrstatus)
+                    {
+                        unsigned int i;
+                        for (i = 0; i < device->intrstatus->ncauses; i++)
+                            if (info->causecount[i] || info->causes[i])
+                                printf("      cause %u mask 0x%llx count: %llu%s\n",
+                                    i+1, (unsigned long long)device->intrstatus->masks[i],
+                                    info->causecount[i], info->causes[i] ? "" : " (no records)");
+                    }
+                    if (device->intrack)
+                    {
+                        mmapIntrAck* ack;
+                        for (ack = device->intrack; ack->op; ack++)
+                            if (ack->op == ACK_READ)
+                                printf("      ack read 0x%"Z"x %u bit\n",
+                                    ack->offset, ack->width*8);
+                            else
+                                printf("      ack %s 0x%"Z"x %u bit 0x%llx\n",
+                                    mmapIntrAckNames[ack->op], ack->offset, ack->width*8,
+                                    (unsigned long long)ack->value);
+                    }
                 }
             }
+#ifdef HAVE_SNAPSHOT
+            if (device->snapshot)
+            {
+                mmapSnapshot* snap = device->snapshot;
+                printf("    snapshot 0x%"Z"x:0x%"Z"x buffers: %u, taken: %llu, overruns: %llu, reads: %llu\n",
+                    snap->offset, snap->size, snap->count, snap->taken, snap->overruns, snap->served);
+            }
+#endif /* HAVE_SNAPSHOT */
+#ifdef HAVE_CAPTURE
+            if (device->capture)
+            {
+                mmapCapture* cap = device->capture;
+                printf("    capture 0x%"Z"x:0x%"Z"x to %s records: %llu, dropped: %llu, bytes: %"Z"u\n",
+                    cap->offset, cap->size, cap->file, cap->records, cap->drops, cap->used);
+            }
+            if (device->replay)
+            {
+                mmapReplayState* replay = device->replay;
+                printf("    replay %s records: %llu, speed: %g, replayed: %llu, runs: %u%s\n",
+                    replay->file, replay->count, replay->speed, replay->replayed, replay->runs,
+                    replay->running ? " (running)" : "");
+            }
+#endif /* HAVE_CAPTURE */
+#ifdef HAVE_PARALLEL
+            if (device->parallelSize)
+                printf("    parallel copy threads: %d, parallel transfers (all devices): %llu, pool busy: %llu\n",
+                    mmapCopyPool.nthreads, mmapCopyPool.jobs, mmapCopyPool.busy);
+#endif /* HAVE_PARALLEL */
+#ifdef HAVE_CHUNK
+            if (device->chunkSize)
+                printf("    chunked transfers gave way to higher priority: %llu times, asynchronous: %llu, overtaken: %llu\n",
+                    device->chunkYields,
+                    device->chunkQueue ? device->chunkQueue->jobs : 0ULL,
+                    device->chunkQueue ? device->chunkQueue->preempted : 0ULL);
+#endif /* HAVE_CHUNK */
+#ifdef HAVE_PUBLISH
+            if (device->publisher)
+                printf("    publish buffers: %u, subscribers: %u, taken: %llu, overruns: %llu\n",
+                    device->publisher->nbuffers, device->publisher->nsubscribers,
+                    (unsigned long long)device->publisher->taken, device->publisher->overruns);
+#endif /* HAVE_PUBLISH */
+#ifdef HAVE_EXPORT
+            if (device->export)
+                printf("    export 0x%"Z"x:0x%"Z"x generation: %llu, updates: %llu\n",
+                    device->export->offset, device->export->size,
+                    (unsigned long long)device->export->header->generation, device->export->updates);
+#endif /* HAVE_EXPORT */
+#ifdef HAVE_MIRROR
+            if (device->mirror)
+            {
+                mmapMirror* mirror = device->mirror;
+                if (mirror->period)
+                    printf("    mirror every %g s%s", mirror->period, mirror->scan ? " with I/O Intr" : "");
+                else
+                    printf("    mirror at interrupts");
+                printf(", refreshes: %llu, reads: %llu\n", mirror->refreshes, mirror->reads);
+            }
+#endif /* HAVE_MIRROR */
+#ifdef HAVE_SHADOW
+            if (device->shadow)
+                printf("    shadow 0x%"Z"x:0x%"Z"x writes: %llu, reads: %llu\n",
+                    device->shadow->offset, device->shadow->size,
+                    device->shadow->writes, device->shadow->reads);
+#endif /* HAVE_SHADOW */
+#ifdef HAVE_PERSIST
+            if (device->persist)
+                printf("    persist every %g s, saved: %llu\n",
+                    device->persistPeriod, device->persistCount);
+#endif /* HAVE_PERSIST */
+#ifdef HAVE_URING
+            if (device->uring)
+            {
+                mmapUring* ring = device->uring;
+                printf("    io_uring submitted: %llu, completed: %llu, batches: %llu, errors: %llu\n",
+                    ring->submitted, ring->completed, ring->batches, ring->errors);
+            }
+#endif /* HAVE_URING */
+#ifdef HAVE_WRITEBEHIND
+            if (device->writeQueue)
+            {
+                mmapWriteQueue* wb = device->writeQueue;
+                printf("    write-behind flushed: %llu, merged: %llu, batches: %llu, overflows: %llu\n",
+                    wb->flushed, wb->merged, wb->batches, wb->overflows);
+            }
+#endif /* HAVE_WRITEBEHIND */
         }
         if (level > 1)
         {
@@ -429,42 +4299,198 @@ void mmapReport(
 }
 
 #ifdef __linux__
-int mmapDevTypeToStr(unsigned int dev, char* pdevname)
-{
+/* Character device types from /proc/devices, read once
+   and read again only if a device type is not found
+*/
+typedef struct mmapCharDevice {
+    unsigned int devnum;
     char devtype[32];
+} mmapCharDevice;
+static mmapCharDevice* mmapCharDevices = NULL;
+static size_t mmapNumCharDevices = 0;
+
+static void mmapReadProcDevices(void)
+{
     FILE* devices = fopen("/proc/devices", "r");
-    if (devices)
-    {
-        unsigned int devnum;
+    mmapCharDevice* table = NULL;
+    size_t n = 0, size = 0;
+    unsigned int devnum;
+    char devtype[32];
 
-        fscanf(devices, "Character devices:");
+    if (!devices) return;
+    if (fscanf(devices, "Character devices:") != EOF)
+    {
         while (fscanf(devices, "%u %31s", &devnum, devtype) == 2)
         {
-            if (devnum == dev)
+            if (n == size)
+            {
+                mmapCharDevice* newtable;
+                size = size ? size * 2 : 64;
+                newtable = realloc(table, size * sizeof(mmapCharDevice));
+                if (!newtable) break;
+                table = newtable;
+            }
+            table[n].devnum = devnum;
+            strcpy(table[n].devtype, devtype);
+            n++;
+        }
+    }
+    fclose(devices);
+    free(mmapCharDevices);
+    mmapCharDevices = table;
+    mmapNumCharDevices = n;
+}
+
+int mmapDevTypeToStr(unsigned int dev, char* pdevname)
+{
+    int reread = 0;
+    size_t i;
+
+    if (!mmapCharDevices)
+    {
+        mmapReadProcDevices();
+        reread = 1;
+    }
+    while (1)
+    {
+        for (i = 0; i < mmapNumCharDevices; i++)
+        {
+            if (mmapCharDevices[i].devnum == dev)
             {
-                fclose(devices);
-                strcpy(pdevname, devtype);
+                strcpy(pdevname, mmapCharDevices[i].devtype);
                 return 1;
             }
         }
-        fclose(devices);
+        if (reread) break;
+        /* maybe a driver has been loaded in the meantime */
+        mmapReadProcDevices();
+        reread = 1;
     }
     pdevname[0] = 0;
     return 0;
 }
-#endif /* __linux__ */
+#endif /* __linux__ */
+
+/* Records of a sharded device are distributed over several scan lists.
+   Devices sharing an interrupt source have their own scan lists. */
+static IOSCANPVT mmapGetShardScanPvt(regDevice *device, mmapIntrInfo *info, size_t offset, const char* user)
+{
+    IOSCANPVT ioscanpvt = NULL;
+    mmapShardSet* set;
+    unsigned int shard;
+
+    epicsMutexMustLock(mmapConnectInterruptLock);
+    for (set = info->shardsets; set; set = set->next)
+        if (set->device == device) break;
+    if (!set)
+    {
+        set = calloc(1, sizeof(mmapShardSet) + (device->shards - 1) * sizeof(IOSCANPVT));
+        if (set)
+        {
+            set->device = device;
+            set->next = info->shardsets;
+            info->shardsets = set;
+        }
+    }
+    if (set)
+    {
+        if (device->shardSize)
+            shard = (offset / device->shardSize) % device->shards;
+        else
+            shard = set->nextshard++ % device->shards;
+        if (!set->shards[shard])
+            scanIoInit(&set->shards[shard]);
+        ioscanpvt = set->shards[shard];
+        if (mmapDebug)
+            printf("mmapGetInScanPvt %s: %s shard %u\n", user, device->name, shard);
+    }
+    epicsMutexUnlock(mmapConnectInterruptLock);
+    return ioscanpvt ? ioscanpvt : info->ioscanpvt;
+}
+
+static IOSCANPVT mmapGetCauseScanPvt(regDevice *device, mmapIntrInfo *info, int cause, size_t offset, const char* user)
+{
+    mmapIntrStatus* st = info->device->intrstatus;
+
+    if (!cause && device->shards > 1)
+        return mmapGetShardScanPvt(device, info, offset, user);
+    if (!cause)
+        return info->ioscanpvt;
+    if (!st || cause > (int)st->ncauses)
+    {
+        errlogSevPrintf(errlogMajor,
+            "mmapGetInScanPvt %s: Interrupt source of %s has no cause %d.\n",
+            user, info->device->name, cause);
+        return NULL;
+    }
+    if (!info->causes[cause-1])
+    {
+        epicsMutexMustLock(mmapConnectInterruptLock);
+        if (!info->causes[cause-1])
+        {
+            IOSCANPVT ioscanpvt;
+            scanIoInit(&ioscanpvt);
+            info->causes[cause-1] = ioscanpvt;
+        }
+        epicsMutexUnlock(mmapConnectInterruptLock);
+    }
+    return info->causes[cause-1];
+}
+
+/* Find the interrupt source or connect it on first use */
+static mmapIntrInfo* mmapFindInterrupt(regDevice *device, int intrvector, int intrlevel, const char* user)
+{
+    mmapIntrInfo *info;
+    mmapIntrInfo *volatile *pinfo;
+
+    pinfo = &intrInfos;
+    while (1) {
+        while ((info=(*pinfo)) != NULL)
+        {
+            /* replay and mirror interrupts belong to one device, all others can be shared */
+            if (info->intrlevel == intrlevel && info->intrvector == intrvector &&
+                ((intrlevel != INTR_REPLAY && intrlevel != INTR_MIRROR) || info->device == device))
+                return info;
+            pinfo = &info->next;
+        }
+        /* Lock before adding */
+        epicsMutexMustLock(mmapConnectInterruptLock);
+        /* has someone added something while we were sleeping ? */
+        if (!*pinfo) break;
+        epicsMutexUnlock(mmapConnectInterruptLock);
+    }
+    if (intrlevel == INTR_REPLAY || intrlevel == INTR_MIRROR)
+        info = mmapConnectSoftInterrupt(user, device, intrlevel);
+    else
+#ifdef HAVE_UIO
+    if (intrlevel == INTR_FD)
+        info = mmapConnectFdInterrupt(user, device, intrvector);
+    else
+    {
+        info = mmapConnectUioInterrupt(user, device, intrvector);
+        if (!info)
+            info = mmapConnectVmeInterrupt(user, device, intrvector, intrlevel);
+    }
+#else /* !HAVE_UIO */
+    info = mmapConnectVmeInterrupt(user, device, intrvector, intrlevel);
+#endif /* !HAVE_UIO */
+    *pinfo = info;
+    epicsMutexUnlock(mmapConnectInterruptLock);
+    return info;
+}
+
 
 IOSCANPVT mmapGetInScanPvt(
     regDevice *device,
-    size_t offset __attribute__((unused)),
+    size_t offset,
     unsigned int dlen __attribute__((unused)),
     size_t nelm __attribute__((unused)),
     int intrvector,
     const char* user)
 {
     mmapIntrInfo *info;
-    mmapIntrInfo *volatile *pinfo;
     int intrlevel = device->intrlevel;
+    int cause = 0;
 
     if (!device || device->magic != MAGIC)
     {
@@ -476,6 +4502,14 @@ IOSCANPVT mmapGetInScanPvt(
         printf("mmapGetInScanPvt %s: %s devtype=%s intrvector=%d=%#x default-intrvector=%d intrlevel=%d default-intrsource=%s\n",
             user, device->name, device->devtype, intrvector, intrvector, device->intrvector, intrlevel, device->intrsource);
 
+    if (intrvector >= 1 << INTR_CAUSE_SHIFT)
+    {
+        /* upper bits select an interrupt cause, lower bits the source (0 = default) */
+        cause = intrvector >> INTR_CAUSE_SHIFT;
+        intrvector &= (1 << INTR_CAUSE_SHIFT) - 1;
+        if (intrvector == 0) intrvector = -1;
+    }
+
     if (intrvector < 0)
     {
         intrvector = device->intrvector;
@@ -487,33 +4521,39 @@ IOSCANPVT mmapGetInScanPvt(
             return NULL;
         }
     }
-
-    pinfo = &intrInfos;
-    while (1) {
-        while ((info=(*pinfo)) != NULL)
-        {
-            if (info->intrlevel == intrlevel && info->intrvector == intrvector)
-                return info->ioscanpvt;
-            pinfo = &info->next;
-        }
-        /* Lock before adding */
-        epicsMutexMustLock(mmapConnectInterruptLock);
-        /* has someone added something while we were sleeping ? */
-        if (!*pinfo) break;
-        epicsMutexUnlock(mmapConnectInterruptLock);
+    else if (intrlevel == INTR_FD || intrlevel == INTR_REPLAY || intrlevel == INTR_MIRROR)
+    {
+        /* file descriptor, replay and mirror sources can only be the default, V selects uio or VME */
+        intrlevel = 0;
     }
-#ifdef HAVE_UIO
-    info = mmapConnectUioInterrupt(user, device, intrvector);
-    if (!info)
-#endif /* HAVE_UIO */
-    info = mmapConnectVmeInterrupt(user, device, intrvector, intrlevel);
-    *pinfo = info;
-    epicsMutexUnlock(mmapConnectInterruptLock);
+
+    info = mmapFindInterrupt(device, intrvector, intrlevel, user);
     if (!info)
         return NULL;
-    return info->ioscanpvt;
+    return mmapGetCauseScanPvt(device, info, cause, offset, user);
 }
 
+/* Connect the default interrupt source even if no record uses I/O Intr,
+   for features that work at each interrupt (capture, mirror, export, publish)
+*/
+static int mmapConnectDeviceInterrupt(regDevice *device, const char* what)
+{
+    if (device->intrvector < 0)
+    {
+        errlogSevPrintf(errlogFatal,
+            "mmapConfigure %s: %s needs an interrupt source.\n",
+            device->name, what);
+        return -1;
+    }
+    if (!mmapFindInterrupt(device, device->intrvector, device->intrlevel, device->name))
+    {
+        errlogSevPrintf(errlogFatal,
+            "mmapConfigure %s: Cannot connect interrupt source %s.\n",
+            device->name, device->intrsource);
+        return -1;
+    }
+    return 0;
+}
 #define mmapGetOutScanPvt mmapGetInScanPvt
 
 #ifdef HAVE_DMA
@@ -526,7 +4566,6 @@ void mmapCancelDma(int handle)
 }
 #endif /* HAVE_DMA */
 
-
 int mmapRead(
     regDevice *device,
     size_t offset,
@@ -545,6 +4584,13 @@ int mmapRead(
             "mmapRead %s: Invalid device handle.\n", user);
         return -1;
     }
+#ifdef HAVE_FILEIO
+    if (device->flags & FILE_DEVICE)
+    {
+        TRACE(TRACE_READ, device, offset, nelem*dlen, TRACE_FILE);
+        return mmapFileTransfer(device, 1, offset, dlen, nelem, pdata, NULL, callback, user);
+    }
+#endif /* HAVE_FILEIO */
     if (!device->localbaseaddress)
     {
         errlogSevPrintf(errlogMajor,
@@ -552,12 +4598,45 @@ int mmapRead(
         return -1;
     }
 
+#ifdef HAVE_WRITEBEHIND
+    /* make sure we read back what has been written */
+    if (device->writeQueue && !mmapWriteQueueDone(device->writeQueue))
+        mmapFlushDevice(device);
+#endif /* HAVE_WRITEBEHIND */
+
+#ifdef HAVE_SNAPSHOT
+    if (device->snapshot && mmapSnapshotRead(device, offset, dlen, nelem, pdata, prio))
+    {
+        mmapSwap(device, pdata, dlen, nelem);
+        TRACE(TRACE_READ, device, offset, nelem*dlen, TRACE_SNAPSHOT);
+        return 0;
+    }
+#endif /* HAVE_SNAPSHOT */
+
+#ifdef HAVE_SHADOW
+    if (device->shadow && mmapShadowRead(device, offset, dlen, nelem, pdata))
+    {
+        mmapSwap(device, pdata, dlen, nelem);
+        TRACE(TRACE_READ, device, offset, nelem*dlen, TRACE_SHADOW);
+        return 0;
+    }
+#endif /* HAVE_SHADOW */
+
+#ifdef HAVE_MIRROR
+    if (device->mirror && mmapMirrorRead(device, offset, dlen, nelem, pdata))
+    {
+        mmapSwap(device, pdata, dlen, nelem);
+        TRACE(TRACE_READ, device, offset, nelem*dlen, TRACE_MIRROR);
+        return 0;
+    }
+#endif /* HAVE_MIRROR */
+
+    CACHE_INVALIDATE(device, offset, nelem*dlen);
     src = device->localbaseaddress+offset;
     if (pdata == src)
     {
-        if (mmapDebug)
-            printf("mmapRead %s %s: Direct map, no copy needed.\n",
-                user, device->name);
+        EXPORT_BLOCK_READ(device, src, offset, nelem*dlen);
+        TRACE(TRACE_READ, device, offset, nelem*dlen, TRACE_DIRECT);
         return 0;
     }
 #ifdef HAVE_DMA
@@ -584,9 +4663,6 @@ int mmapRead(
             default:
                 goto noDmaRead;
         }
-        if (mmapDebug)
-            printf("mmapRead %s %s: DMA transfer from %p to %p, 0x%"Z"x * %d bit\n",
-                user, device->name, device->localbaseaddress+offset, pdata, nelem, dlen*8);
         while (1)
         {
 #ifdef dmaTransferRequest_can_wait
@@ -611,14 +4687,16 @@ int mmapRead(
                 if (dmaStatus == DMA_BUSERR && dlen == 8 && device->maxDmaSpeed > 0)
                 {
                     /* try again with a slower DMA speed */
-                    if (mmapDebug)
-                        printf("mmapRead %s %s: DMA mode %s failed. Trying slower speed.\n",
-                            user, device->name, dmaModeStr[device->maxDmaSpeed]);
+                    errlogSevPrintf(errlogMinor,
+                        "mmapRead %s %s: DMA mode %s failed. Trying slower speed.\n",
+                        user, device->name, dmaModeStr[device->maxDmaSpeed]);
                     device->maxDmaSpeed--;
                     continue;
                 }
                 if (dmaStatus == DMA_DONE)
                 {
+                    EXPORT_BLOCK_READ(device, (char*)pdata, offset, nelem*dlen);
+                    TRACE(TRACE_READ, device, offset, nelem*dlen, TRACE_DMA);
                     return 0;
                 }
                 errlogSevPrintf(errlogMajor,
@@ -638,40 +4716,28 @@ int mmapRead(
                    * queue full
                    * unaligned access (already checked before)
                 */
-                if (mmapDebug)
-                    printf("mmapRead %s %s: DMA mode %s failed.\n",
-                        user, device->name, dmaModeStr[device->maxDmaSpeed]);
                 break;
             }
         }
     }
 noDmaRead:
 #endif /* HAVE_DMA */
-    if (mmapDebug)
-        printf("mmapRead %s %s: Normal transfer from %p to %p, 0x%"Z"x * %d bit\n",
-            user, device->name, device->localbaseaddress+offset, pdata, nelem, dlen*8);
-    regDevCopy(dlen, nelem, src, pdata, NULL, 0);
-    if (device->flags & SWAP_DWORD_PAIRS)
-    {
-        epicsUInt64* p = pdata;
-        size_t i;
-        for (i = 0; i < nelem*dlen/8; i++)
-            p[i] = p[i] >> 32 | p[i] << 32;
-    }
-    if (device->flags & SWAP_WORD_PAIRS)
+#ifdef HAVE_CHUNK
+    if (device->chunkSize)
+        return mmapChunkTransfer(device, 1, offset, dlen, nelem, pdata, NULL, prio, callback, user);
+#endif /* HAVE_CHUNK */
+#ifdef HAVE_PARALLEL
+    if (device->parallelSize && nelem*dlen >= device->parallelSize &&
+        mmapParallelCopy(device, src, pdata, dlen, nelem, 1) == 0)
     {
-        epicsUInt32* p = pdata;
-        size_t i;
-        for (i = 0; i < nelem*dlen/4; i++)
-            p[i] = p[i] >> 16 | p[i] << 16;
-    }
-    if (device->flags & SWAP_BYTE_PAIRS)
-    {
-        epicsUInt16* p = pdata;
-        size_t i;
-        for (i = 0; i < nelem*dlen/2; i++)
-            p[i] = p[i] >> 8 | p[i] << 8;
+        TRACE(TRACE_READ, device, offset, nelem*dlen, TRACE_PARALLEL);
+        return 0;
     }
+#endif /* HAVE_PARALLEL */
+    regDevCopy(dlen, nelem, src, pdata, NULL, 0);
+    EXPORT_BLOCK_READ(device, pdata, offset, nelem*dlen);
+    mmapSwap(device, pdata, dlen, nelem);
+    TRACE(TRACE_READ, device, offset, nelem*dlen, TRACE_MAP);
     return 0;
 }
 
@@ -700,6 +4766,13 @@ int mmapWrite(
             "mmapWrite %s %s: Device is read-only.\n", user, device->name);
         return -1;
     }
+#ifdef HAVE_FILEIO
+    if (device->flags & FILE_DEVICE)
+    {
+        TRACE(TRACE_WRITE, device, offset, nelem*dlen, TRACE_FILE);
+        return mmapFileTransfer(device, 0, offset, dlen, nelem, pdata, pmask, callback, user);
+    }
+#endif /* HAVE_FILEIO */
     if (!device->localbaseaddress)
     {
         errlogSevPrintf(errlogMajor,
@@ -710,11 +4783,37 @@ int mmapWrite(
     dst = device->localbaseaddress+offset;
     if (pdata == dst)
     {
-        if (mmapDebug)
-            printf("mmapWrite %s %s: Direct map, no copy needed.\n",
-                user, device->name);
+        CACHE_FLUSH(device, offset, nelem*dlen);
+        TRACE(TRACE_WRITE, device, offset, nelem*dlen, TRACE_DIRECT);
         return 0;
     }
+#ifdef HAVE_MIRROR
+    if (device->mirror)
+        mmapMirrorWrite(device, offset, dlen, nelem, pdata, pmask);
+#endif /* HAVE_MIRROR */
+#ifdef HAVE_SHADOW
+    if (device->shadow && mmapShadowWrite(device, offset, dlen, nelem, pdata, pmask))
+    {
+        TRACE(TRACE_WRITE, device, offset, nelem*dlen, TRACE_SHADOW);
+        return 0;
+    }
+#endif /* HAVE_SHADOW */
+#ifdef HAVE_WRITEBEHIND
+    if (device->writeQueue)
+    {
+        if (dlen <= 8 && nelem*dlen <= WB_DATA_SIZE)
+        {
+            if (mmapWriteQueuePut(device->writeQueue, offset, dlen, nelem, pdata, pmask) == 0)
+            {
+                TRACE(TRACE_WRITE, device, offset, nelem*dlen, TRACE_QUEUE);
+                return 0;
+            }
+            __atomic_add_fetch(&device->writeQueue->overflows, 1, __ATOMIC_RELAXED);
+        }
+        /* large write or queue full: write pending data first to keep order */
+        mmapFlushDevice(device);
+    }
+#endif /* HAVE_WRITEBEHIND */
 #ifdef HAVE_DMA
     /* Try DMA for long arrays */
     if (pmask == NULL &&                          /* cannot use read-modify-write with DMA */
@@ -740,9 +4839,6 @@ int mmapWrite(
             default:
                 goto noDmaWrite;
         }
-        if (mmapDebug)
-            printf("mmapWrite %s %s: DMA transfer from %p to %p, 0x%"Z"x * %d bit\n",
-                user, device->name, pdata, device->localbaseaddress+offset, nelem, dlen*8);
         while (1)
         {
 #ifdef dmaTransferRequest_can_wait
@@ -767,14 +4863,15 @@ int mmapWrite(
                 if (dmaStatus == DMA_BUSERR && dlen == 8 && device->maxDmaSpeed > 0)
                 {
                     /* try again with a slower DMA speed */
-                    if (mmapDebug)
-                        printf("mmapWrite %s %s: DMA mode %s failed. Trying slower speed.\n",
-                            user, device->name, dmaModeStr[device->maxDmaSpeed]);
+                    errlogSevPrintf(errlogMinor,
+                        "mmapWrite %s %s: DMA mode %s failed. Trying slower speed.\n",
+                        user, device->name, dmaModeStr[device->maxDmaSpeed]);
                     device->maxDmaSpeed--;
                     continue;
                 }
                 if (dmaStatus == DMA_DONE)
                 {
+                    TRACE(TRACE_WRITE, device, offset, nelem*dlen, TRACE_DMA);
                     return 0;
                 }
                 errlogSevPrintf(errlogMajor,
@@ -794,58 +4891,414 @@ int mmapWrite(
                    * queue full
                    * unaligned access (already checked before)
                 */
-                if (mmapDebug)
-                    printf("mmapWrite %s %s: DMA mode %s failed.\n",
-                        user, device->name, dmaModeStr[device->maxDmaSpeed]);
                 break;
             }
         }
     }
 noDmaWrite:
 #endif /* HAVE_DMA */
-    if (mmapDebug)
-        printf("mmapWrite %s %s: Transfer from %p to %p, 0x%"Z"x * %d bit\n",
-            user, device->name, pdata, dst, nelem, dlen*8);
-    regDevCopy(dlen, nelem, pdata, dst, pmask, 0);
+#ifdef HAVE_CHUNK
+    if (device->chunkSize)
+        return mmapChunkTransfer(device, 0, offset, dlen, nelem, pdata, pmask, prio, callback, user);
+#endif /* HAVE_CHUNK */
+#ifdef HAVE_PARALLEL
+    if (!pmask && device->parallelSize && nelem*dlen >= device->parallelSize &&
+        mmapParallelCopy(device, pdata, dst, dlen, nelem, 0) == 0)
+    {
+        CACHE_FLUSH(device, offset, nelem*dlen);
+        SYNC
+        TRACE(TRACE_WRITE, device, offset, nelem*dlen, TRACE_PARALLEL);
+        return 0;
+    }
+#endif /* HAVE_PARALLEL */
+    if (pmask)
+        CACHE_INVALIDATE(device, offset, nelem*dlen);
+#ifdef HAVE_ATOMIC
+    if (pmask && SHARED_MEMORY(device) && mmapAtomicMaskedWrite(dlen, nelem, pdata, dst, pmask))
+    {
+        CACHE_FLUSH(device, offset, nelem*dlen);
+        SYNC
+        TRACE(TRACE_WRITE, device, offset, nelem*dlen, TRACE_ATOMIC);
+        return 0;
+    }
+#endif /* HAVE_ATOMIC */
+    if (pmask && (device->flags & MEMORY_DEVICE) && (dlen == 1 || dlen == 2 || dlen == 4 || dlen == 8))
+        mmapMaskedCopy(dlen, nelem, pdata, (char*)dst, pmask);
+    else
+        regDevCopy(dlen, nelem, pdata, dst, pmask, 0);
+    CACHE_FLUSH(device, offset, nelem*dlen);
+    SYNC
+    TRACE(TRACE_WRITE, device, offset, nelem*dlen, pmask ? TRACE_MASKED : TRACE_MAP);
+    return 0;
+}
+
+static regDevSupport mmapSupport = {
+    mmapReport,
+    mmapGetInScanPvt,
+    mmapGetOutScanPvt,
+    mmapRead,
+    mmapWrite
+};
+
+int mmapIntAckSetBits16(regDevice *device)
+{
+    size_t offset = (size_t) device->userdata >> 16;
+    size_t bits   = (size_t) device->userdata & 0xFFFF;
+    *(epicsInt16*)(device->localbaseaddress+offset) |= bits;
+    SYNC
+    return 0;
+}
+
+int mmapIntAckClearBits16(regDevice *device)
+{
+    size_t offset = (size_t) device->userdata >> 16;
+    size_t bits   = (size_t) device->userdata & 0xFFFF;
+    *(epicsInt16*)(device->localbaseaddress+offset) &= ~bits;
     SYNC
     return 0;
 }
 
-static regDevSupport mmapSupport = {
-    mmapReport,
-    mmapGetInScanPvt,
-    mmapGetOutScanPvt,
-    mmapRead,
-    mmapWrite
-};
+#ifdef HAVE_dmaAlloc
+void* mmapDmaAlloc(
+    regDevice *device,
+    void* old,
+    size_t size)
+{
+    return dmaRealloc(old, size);
+}
+#endif /* HAVE_dmaAlloc */
+
+#ifdef HAVE_PERSIST
+/* Persistent simulation: the memory of a sim device is a shared
+   file mapping, written to disk by a background thread and at exit.
+   At startup, the previous image is mapped back in place.
+*/
+
+#define PERSIST_DEFAULT_PERIOD 10.0
+
+static void mmapPersistSync(regDevice *device, int flags)
+{
+    size_t pagesize = sysconf(_SC_PAGE_SIZE);
+    char* start = (char*)((size_t)device->localbaseaddress & ~(pagesize-1));
+
+    if (msync(start, device->size + ((char*)device->localbaseaddress - start), flags) != 0)
+        errlogSevPrintf(errlogMajor,
+            "mmapPersistSync %s: msync %s failed: %s\n",
+            device->name, device->persist, strerror(errno));
+    else
+        device->persistCount++;
+}
+
+static void mmapPersistThread(void* arg)
+{
+    regDevice *device = arg;
+
+    while (1)
+    {
+        epicsThreadSleep(device->persistPeriod);
+        mmapPersistSync(device, MS_SYNC);
+    }
+}
+
+static void mmapPersistExit(void* arg)
+{
+    regDevice *device = arg;
+
+    if (mmapDebug)
+        printf("mmapPersistExit %s: writing %s\n",
+            device->name, device->persist);
+    mmapPersistSync(device, MS_SYNC);
+}
+
+static char* mmapPersistMap(const char* name, const char* persist, size_t size)
+{
+    struct stat sb;
+    char* map;
+    int fd;
+
+    fd = open(persist, O_RDWR | O_CREAT | O_CLOEXEC, 0666);
+    if (fd < 0)
+    {
+        errlogSevPrintf(errlogFatal,
+            "mmapConfigure %s: Cannot open %s: %s\n",
+            name, persist, strerror(errno));
+        return NULL;
+    }
+    if (fstat(fd, &sb) != 0 || (size_t)sb.st_size < size)
+    {
+        if (mmapDebug)
+            printf("mmapConfigure %s: %s new image of %"Z"u bytes\n",
+                name, persist, size);
+        if (ftruncate(fd, size) != 0)
+        {
+            errlogSevPrintf(errlogFatal,
+                "mmapConfigure %s: Cannot grow %s to %"Z"u bytes: %s\n",
+                name, persist, size, strerror(errno));
+            close(fd);
+            return NULL;
+        }
+    }
+    else if (mmapDebug)
+        printf("mmapConfigure %s: restoring image from %s\n",
+            name, persist);
+    map = mmap(NULL, size, PROT_READ|PROT_WRITE, MAP_SHARED, fd, 0);
+    close(fd);
+    if (map == MAP_FAILED)
+    {
+        errlogSevPrintf(errlogFatal,
+            "mmapConfigure %s: Cannot mmap %s: %s\n",
+            name, persist, strerror(errno));
+        return NULL;
+    }
+    return map;
+}
+
+static int mmapStartPersist(regDevice *device, double period)
+{
+    char threadname[32];
+
+    device->persistPeriod = period > 0 ? period : PERSIST_DEFAULT_PERIOD;
+    epicsAtExit(mmapPersistExit, device);
+    sprintf(threadname, "%.24s-sync", device->name);
+    if (!epicsThreadCreate(threadname, epicsThreadPriorityLow,
+        epicsThreadGetStackSize(epicsThreadStackSmall),
+        mmapPersistThread, device))
+    {
+        errlogSevPrintf(errlogMajor,
+            "mmapConfigure %s: epicsThreadCreate for persistence failed: %s. Saving only at exit.\n",
+            device->name, strerror(errno));
+        return -1;
+    }
+    return 0;
+}
+#endif /* HAVE_PERSIST */
+
+#ifdef HAVE_MEMFD
+/* Simulation on a memfd: other processes can map the same memory,
+   either through /proc/<pid>/fd/<fd> or by receiving the file descriptor
+   from a UNIX socket.
+*/
+
+static char* mmapMemfdMap(const char* name, size_t size, int seal, int* pfd)
+{
+    char* map;
+    int fd;
+
+    fd = syscall(SYS_memfd_create, name, MFD_CLOEXEC | (seal ? MFD_ALLOW_SEALING : 0));
+    if (fd < 0)
+    {
+        errlogSevPrintf(errlogFatal,
+            "mmapConfigure %s: memfd_create failed: %s\n",
+            name, strerror(errno));
+        return NULL;
+    }
+    if (ftruncate(fd, size) != 0)
+    {
+        errlogSevPrintf(errlogFatal,
+            "mmapConfigure %s: Cannot grow memfd to %"Z"u bytes: %s\n",
+            name, size, strerror(errno));
+        close(fd);
+        return NULL;
+    }
+    /* other processes must not be able to change the size under our map */
+    if (seal && fcntl(fd, F_ADD_SEALS, F_SEAL_SHRINK|F_SEAL_GROW|F_SEAL_SEAL) != 0)
+    {
+        errlogSevPrintf(errlogFatal,
+            "mmapConfigure %s: Cannot seal memfd: %s\n",
+            name, strerror(errno));
+        close(fd);
+        return NULL;
+    }
+    map = mmap(NULL, size, PROT_READ|PROT_WRITE, MAP_SHARED, fd, 0);
+    if (map == MAP_FAILED)
+    {
+        errlogSevPrintf(errlogFatal,
+            "mmapConfigure %s: Cannot mmap memfd: %s\n",
+            name, strerror(errno));
+        close(fd);
+        return NULL;
+    }
+    *pfd = fd;
+    return map;
+}
+
+static void mmapMemfdServerThread(void* arg)
+{
+    regDevice *device = arg;
+    int sock = device->memfdListen;
+    int client;
+
+    while (1)
+    {
+        /* send the memfd with the device size as payload */
+        epicsUInt64 size = device->size;
+        struct iovec iov = { &size, sizeof(size) };
+        union {
+            struct cmsghdr hdr;
+            char buf[CMSG_SPACE(sizeof(int))];
+        } control;
+        struct msghdr msg;
+        struct cmsghdr *cmsg;
+
+        client = accept(sock, NULL, NULL);
+        if (client < 0)
+        {
+            if (errno == EINTR || errno == ECONNABORTED) continue;
+            break;
+        }
+        memset(&msg, 0, sizeof(msg));
+        memset(&control, 0, sizeof(control));
+        msg.msg_iov = &iov;
+        msg.msg_iovlen = 1;
+        msg.msg_control = control.buf;
+        msg.msg_controllen = sizeof(control.buf);
+        cmsg = CMSG_FIRSTHDR(&msg);
+        cmsg->cmsg_level = SOL_SOCKET;
+        cmsg->cmsg_type = SCM_RIGHTS;
+        cmsg->cmsg_len = CMSG_LEN(sizeof(int));
+        memcpy(CMSG_DATA(cmsg), &device->memfd, sizeof(int));
+        if (sendmsg(client, &msg, MSG_NOSIGNAL) == sizeof(size))
+            device->memfdClients++;
+        else if (mmapDebug)
+            printf("mmapMemfdServerThread %s: sendmsg failed: %s\n",
+                device->name, strerror(errno));
+        close(client);
+    }
+    errlogSevPrintf(errlogMajor,
+        "mmapMemfdServerThread %s: accept on %s failed: %s\n",
+        device->name, device->memfdSocket, strerror(errno));
+    close(sock);
+}
+
+static void mmapMemfdExit(void* arg)
+{
+    regDevice *device = arg;
+
+    unlink(device->memfdSocket);
+}
+
+static int mmapStartMemfdServer(regDevice *device, const char* path)
+{
+    struct sockaddr_un addr;
+    struct stat sb;
+    char threadname[32];
+    int sock;
+
+    if (strlen(path) >= sizeof(addr.sun_path))
+    {
+        errlogSevPrintf(errlogFatal,
+            "mmapConfigure %s: Socket path %s too long.\n",
+            device->name, path);
+        return -1;
+    }
+    memset(&addr, 0, sizeof(addr));
+    addr.sun_family = AF_UNIX;
+    strcpy(addr.sun_path, path);
+    sock = socket(AF_UNIX, SOCK_STREAM | SOCK_CLOEXEC, 0);
+    if (sock >= 0)
+    {
+        /* remove stale socket from previous run */
+        if (stat(path, &sb) == 0 && S_ISSOCK(sb.st_mode))
+            unlink(path);
+        if (bind(sock, (struct sockaddr*)&addr, sizeof(addr)) != 0 || listen(sock, 8) != 0)
+        {
+            close(sock);
+            sock = -1;
+        }
+    }
+    if (sock < 0)
+    {
+        errlogSevPrintf(errlogFatal,
+            "mmapConfigure %s: Cannot listen on %s: %s\n",
+            device->name, path, strerror(errno));
+        return -1;
+    }
+    device->memfdSocket = strdup(path);
+    device->memfdListen = sock;
+    epicsAtExit(mmapMemfdExit, device);
+    sprintf(threadname, "%.24s-memfd", device->name);
+    if (!epicsThreadCreate(threadname, epicsThreadPriorityLow,
+        epicsThreadGetStackSize(epicsThreadStackSmall),
+        mmapMemfdServerThread, device))
+    {
+        errlogSevPrintf(errlogFatal,
+            "mmapConfigure %s: epicsThreadCreate for memfd socket failed: %s\n",
+            device->name, strerror(errno));
+        close(sock);
+        return -1;
+    }
+    return 0;
+}
+#endif /* HAVE_MEMFD */
+
+#ifdef HAVE_MMAP
+/* Devices in parts of the same file (e.g. a PCI BAR split into many devices)
+   share one mapping of the whole file, made when the first device is configured.
+   Mappings are never unmapped because devices point into them.
+*/
+typedef struct mmapMapping {
+    struct mmapMapping* next;
+    dev_t dev;
+    ino_t ino;
+    int prot;
+    int openflags;
+    size_t size;
+    char* base;
+    unsigned int users;
+} mmapMapping;
+static mmapMapping* mmapMappings = NULL;
 
-int mmapIntAckSetBits16(regDevice *device)
+static void* mmapSharedMap(const char* name, int fd, const struct stat* sb, off_t start, size_t size,
+    int prot, int openflags)
 {
-    size_t offset = (size_t) device->userdata >> 16;
-    size_t bits   = (size_t) device->userdata & 0xFFFF;
-    *(epicsInt16*)(device->localbaseaddress+offset) |= bits;
-    SYNC
-    return 0;
-}
+    mmapMapping* m;
+    size_t filesize;
+    void* base;
 
-int mmapIntAckClearBits16(regDevice *device)
-{
-    size_t offset = (size_t) device->userdata >> 16;
-    size_t bits   = (size_t) device->userdata & 0xFFFF;
-    *(epicsInt16*)(device->localbaseaddress+offset) &= ~bits;
-    SYNC
-    return 0;
-}
+    for (m = mmapMappings; m; m = m->next)
+    {
+        if (m->dev != sb->st_dev || m->ino != sb->st_ino || m->prot != prot || m->openflags != openflags)
+            continue;
+        if (start + size <= m->size)
+        {
+            m->users++;
+            if (mmapDebug)
+                printf("mmapConfigure %s: Sharing mapping %p of 0x%"Z"x bytes with %u other devices.\n",
+                    name, m->base, m->size, m->users-1);
+            return m->base + start;
+        }
+        /* the file has grown since it was mapped */
+        if (mmapDebug)
+            printf("mmapConfigure %s: Range beyond shared mapping %p of 0x%"Z"x bytes. Mapping it separately.\n",
+                name, m->base, m->size);
+        return mmap(NULL, size, prot, MAP_SHARED, fd, start);
+    }
 
-#ifdef HAVE_dmaAlloc
-void* mmapDmaAlloc(
-    regDevice *device,
-    void* old,
-    size_t size)
-{
-    return dmaRealloc(old, size);
+    /* st_size may predate growing the file for this device */
+    filesize = (size_t)sb->st_size > start + size ? (size_t)sb->st_size : start + size;
+    base = mmap(NULL, filesize, prot, MAP_SHARED, fd, 0);
+    if (base == MAP_FAILED)
+        return base;
+    if (mmapDebug)
+        printf("mmapConfigure %s: Mapped whole file to %p, 0x%"Z"x bytes.\n",
+            name, base, filesize);
+    m = calloc(1, sizeof(mmapMapping));
+    if (m)
+    {
+        m->dev = sb->st_dev;
+        m->ino = sb->st_ino;
+        m->prot = prot;
+        m->openflags = openflags;
+        m->size = filesize;
+        m->base = base;
+        m->users = 1;
+        m->next = mmapMappings;
+        mmapMappings = m;
+    }
+    /* else just do not share it */
+    return (char*)base + start;
 }
-#endif /* HAVE_dmaAlloc */
+#endif /* HAVE_MMAP */
 
 /****** startup script configuration function ***********************/
 
@@ -882,6 +5335,54 @@ int mmapConfigure(
 #endif
     int missingIntrSevr = errlogFatal;
 #endif /* !vxWorks */
+#ifdef HAVE_WRITEBEHIND
+    size_t writeBehindSize = 0;
+#endif /* HAVE_WRITEBEHIND */
+    char* intrstatus = NULL;
+    char* intrcauses = NULL;
+    char* intrack = NULL;
+    char* shards = NULL;
+#ifdef HAVE_SNAPSHOT
+    char* snapshot = NULL;
+#endif /* HAVE_SNAPSHOT */
+#ifdef HAVE_SHADOW
+    char* shadow = NULL;
+#endif /* HAVE_SHADOW */
+#ifdef HAVE_MIRROR
+    char* mirror = NULL;
+#endif /* HAVE_MIRROR */
+#ifdef HAVE_EXPORT
+    char* export = NULL;
+#endif /* HAVE_EXPORT */
+#ifdef HAVE_PUBLISH
+    char* publish = NULL;
+#endif /* HAVE_PUBLISH */
+#ifdef HAVE_CAPTURE
+    char* capture = NULL;
+    char* replay = NULL;
+#endif /* HAVE_CAPTURE */
+#ifdef HAVE_PARALLEL
+    int parallel = 0;
+    char* parallelSpec = NULL;
+#endif /* HAVE_PARALLEL */
+#ifdef HAVE_CHUNK
+    int chunk = 0;
+    char* chunkSpec = NULL;
+#endif /* HAVE_CHUNK */
+#ifdef HAVE_PERSIST
+    char* persist = NULL;
+    double persistPeriod = 0;
+#endif /* HAVE_PERSIST */
+#ifdef HAVE_FILEIO
+    int fileDescriptor = -1;
+    unsigned int fileQueueSize = 0;
+#endif /* HAVE_FILEIO */
+#ifdef HAVE_MEMFD
+    int memfd = 0;
+    int memfdSeal = 0;
+    int memfdDescriptor = -1;
+    char* memfdSocket = NULL;
+#endif /* HAVE_MEMFD */
 
     if (name == NULL)
     {
@@ -918,12 +5419,15 @@ int mmapConfigure(
     if (addrspace) {
         char* thisflag;
         char* nextflag;
+        char* value;
         nextflag = strchr(addrspace, '&');
         if (nextflag) *nextflag++ = 0;
         while (nextflag) {
             thisflag = nextflag;
             nextflag = strpbrk(thisflag, "&|,;+ ");
             if (nextflag) *nextflag++ = 0;
+            value = strchr(thisflag, '=');
+            if (value) *value++ = 0;
             if (strcasecmp(thisflag, "SwapDwordPairs") == 0) flags ^= SWAP_DWORD_PAIRS;
             else if (strcasecmp(thisflag, "SwapWordPairs") == 0) flags ^= SWAP_WORD_PAIRS;
             else if (strcasecmp(thisflag, "SwapBytePairs") == 0) flags ^= SWAP_BYTE_PAIRS;
@@ -934,7 +5438,60 @@ int mmapConfigure(
             else if (strcasecmp(thisflag, "dma") == 0) flags |= ALLOW_DMA;
 #endif
             else if (strcasecmp(thisflag, "block") == 0) flags |= BLOCK_DEVICE;
+            else if (strcasecmp(thisflag, "memory") == 0) flags |= MEMORY_DEVICE;
+#ifdef HAVE_MMAP
+            else if (strcasecmp(thisflag, "cached") == 0) flags |= CACHED_DEVICE;
+            else if (strcasecmp(thisflag, "uncached") == 0) flags |= UNCACHED_DEVICE;
+#endif /* HAVE_MMAP */
             else if (strcasecmp(thisflag, "map") == 0) flags |= MAP_DEVICE|BLOCK_DEVICE;
+#ifdef HAVE_WRITEBEHIND
+            else if (strcasecmp(thisflag, "writebehind") == 0)
+                writeBehindSize = value ? strtoul(value, NULL, 0) : WB_DEFAULT_SIZE;
+#endif /* HAVE_WRITEBEHIND */
+#ifdef HAVE_SHADOW
+            else if (strcasecmp(thisflag, "shadow") == 0 && value) shadow = value;
+#endif /* HAVE_SHADOW */
+#ifdef HAVE_MIRROR
+            else if (strcasecmp(thisflag, "mirror") == 0 && value) mirror = value;
+#endif /* HAVE_MIRROR */
+#ifdef HAVE_EXPORT
+            else if (strcasecmp(thisflag, "export") == 0 && value) export = value;
+#endif /* HAVE_EXPORT */
+#ifdef HAVE_PUBLISH
+            else if (strcasecmp(thisflag, "publish") == 0 && value) publish = value;
+#endif /* HAVE_PUBLISH */
+#ifdef HAVE_CAPTURE
+            else if (strcasecmp(thisflag, "capture") == 0 && value) capture = value;
+            else if (strcasecmp(thisflag, "replay") == 0 && value) replay = value;
+#endif /* HAVE_CAPTURE */
+#ifdef HAVE_PARALLEL
+            else if (strcasecmp(thisflag, "parallel") == 0) { parallel = 1; parallelSpec = value; }
+#endif /* HAVE_PARALLEL */
+#ifdef HAVE_CHUNK
+            else if (strcasecmp(thisflag, "chunk") == 0) { chunk = 1; chunkSpec = value; }
+#endif /* HAVE_CHUNK */
+            else if (strcasecmp(thisflag, "intrstatus") == 0 && value) intrstatus = value;
+            else if (strcasecmp(thisflag, "intrcauses") == 0 && value) intrcauses = value;
+            else if (strcasecmp(thisflag, "intrack") == 0 && value) intrack = value;
+            else if (strcasecmp(thisflag, "shards") == 0 && value) shards = value;
+#ifdef HAVE_SNAPSHOT
+            else if (strcasecmp(thisflag, "snapshot") == 0 && value) snapshot = value;
+#endif /* HAVE_SNAPSHOT */
+#ifdef HAVE_PERSIST
+            else if (strcasecmp(thisflag, "persist") == 0 && value) persist = value;
+            else if (strcasecmp(thisflag, "persistperiod") == 0 && value) persistPeriod = strtod(value, NULL);
+#endif /* HAVE_PERSIST */
+#ifdef HAVE_MEMFD
+            else if (strcasecmp(thisflag, "memfd") == 0) { memfd = 1; memfdSocket = value; }
+            else if (strcasecmp(thisflag, "seal") == 0) memfdSeal = 1;
+#endif /* HAVE_MEMFD */
+#ifdef HAVE_FILEIO
+            else if (strcasecmp(thisflag, "fileio") == 0)
+            {
+                flags |= FILE_DEVICE;
+                if (value) fileQueueSize = strtoul(value, NULL, 0);
+            }
+#endif /* HAVE_FILEIO */
             else fprintf(stderr, "Unknown flag %s\n", thisflag);
         }
     }
@@ -961,7 +5518,23 @@ int mmapConfigure(
             if (mmapDebug)
                 printf("mmapConfigure %s: checking type of %s\n",
                     name, intrsource);
-            if (stat(intrsource, &sb) < 0)
+            if (strncmp(intrsource, "fd=", 3) == 0 || strncmp(intrsource, "unix:", 5) == 0 ||
+                (stat(intrsource, &sb) == 0 && (S_ISFIFO(sb.st_mode) || S_ISSOCK(sb.st_mode))))
+            {
+                intrvector = mmapFdSourceId(intrsource);
+                intrlevel = INTR_FD;
+                if (intrvector < 0)
+                {
+                    errlogSevPrintf(errlogFatal,
+                        "mmapConfigure %s: Too many interrupt sources.\n",
+                        name);
+                    return -1;
+                }
+                if (mmapDebug)
+                    printf("mmapConfigure %s: default interrupts from %s.\n",
+                        name, intrsource);
+            }
+            else if (stat(intrsource, &sb) < 0)
             {
                 if (missingIntrSevr == errlogFatal) {
                     errlogSevPrintf(errlogFatal,
@@ -1075,14 +5648,53 @@ int mmapConfigure(
         else
         if (vmespace == -1)
         {
-            /* Simulation runs on allocated memory */
-            localbaseaddress = calloc(1, size);
-            if (localbaseaddress == NULL)
+            flags |= MEMORY_DEVICE;
+#ifdef HAVE_MEMFD
+            if (memfd)
             {
-                errlogSevPrintf(errlogFatal,
-                    "mmapConfigure %s: Out of memory allocating %d bytes of simulated address space.\n",
-                    name, size);
-                return errno;
+#ifdef HAVE_PERSIST
+                if (persist)
+                {
+                    errlogSevPrintf(errlogFatal,
+                        "mmapConfigure %s: Options memfd and persist are incompatible.\n", name);
+                    return -1;
+                }
+#endif /* HAVE_PERSIST */
+                localbaseaddress = mmapMemfdMap(name, size, memfdSeal, &memfdDescriptor);
+                if (localbaseaddress == NULL)
+                    return errno ? errno : -1;
+                flags |= SHARED_DEVICE;
+            }
+            else
+#endif /* HAVE_MEMFD */
+#ifdef HAVE_PERSIST
+            if (persist)
+            {
+                localbaseaddress = mmapPersistMap(name, persist, size);
+                if (localbaseaddress == NULL)
+                    return errno ? errno : -1;
+                flags |= SHARED_DEVICE;
+            }
+            else
+#endif /* HAVE_PERSIST */
+            {
+                /* Simulation runs on allocated memory */
+#ifdef HAVE_MMAP
+                /* Anonymous pages are zero, page aligned and only use memory when touched */
+                localbaseaddress = mmap(NULL, size, PROT_READ|PROT_WRITE,
+                    MAP_PRIVATE|MAP_ANONYMOUS|MAP_NORESERVE, -1, 0);
+                if (localbaseaddress == MAP_FAILED)
+                    localbaseaddress = NULL;
+#else /* !HAVE_MMAP */
+                localbaseaddress = calloc(1, size);
+#endif /* !HAVE_MMAP */
+                if (localbaseaddress == NULL)
+                {
+                    errlogSevPrintf(errlogFatal,
+                        "mmapConfigure %s: Out of memory allocating %d bytes of simulated address space.\n",
+                        name, size);
+                    return errno;
+                }
             }
             if (mmapDebug)
                 printf("mmapConfigure %s: simulation @%p\n",
@@ -1092,6 +5704,8 @@ int mmapConfigure(
         else
         {
             int fd;
+            int openflags;
+            int shareable = 0;
             unsigned long mapstart;
             size_t mapsize;
 
@@ -1103,12 +5717,21 @@ int mmapConfigure(
             mapstart = baseaddress & ~((off_t)(sysconf(_SC_PAGE_SIZE)-1));
             mapsize = size + (baseaddress - mapstart);
 
+            if ((flags & (CACHED_DEVICE|UNCACHED_DEVICE)) == (CACHED_DEVICE|UNCACHED_DEVICE))
+            {
+                errlogSevPrintf(errlogFatal,
+                    "mmapConfigure %s: Options cached and uncached are incompatible.\n", name);
+                return -1;
+            }
+            /* O_SYNC makes /dev/mem map RAM uncached */
+            openflags = flags & UNCACHED_DEVICE ? O_SYNC : 0;
+
             /* first try to open read/write, create if necessary (and possible) */
-            fd = open(addrspace, O_RDWR | O_CREAT | O_CLOEXEC, 0777);
+            fd = open(addrspace, O_RDWR | O_CREAT | O_CLOEXEC | openflags, 0777);
             if (fd < 0)
             {
                 /* cannot open R/W or cannot create: try to open readonly */
-                fd = open(addrspace, O_RDONLY | O_CLOEXEC);
+                fd = open(addrspace, O_RDONLY | O_CLOEXEC | openflags);
                 if (fd < 0)
                 {
                     errlogSevPrintf(errlogFatal,
@@ -1128,6 +5751,19 @@ int mmapConfigure(
             /* check (regular) file size (if we cannot let's just hope for the best) and grow if necessary */
             if (fstat(fd, &sb) != -1)
             {
+                /* only files with a size where the offset is a linear address can share
+                   a mapping of the whole file, e.g. not /dev/mem or uio devices */
+                if (S_ISREG(sb.st_mode))
+                    shareable = 1;
+                if (S_ISREG(sb.st_mode))
+                {
+                    /* regular files (e.g. in /dev/shm) are ordinary memory, but pci resources in sysfs are not */
+#ifdef __linux__
+                    struct statfs sfs;
+                    if (fstatfs(fd, &sfs) != 0 || sfs.f_type != SYSFS_MAGIC)
+#endif /* __linux__ */
+                        flags |= MEMORY_DEVICE;
+                }
                 if (S_ISREG(sb.st_mode) && mapsize + mapstart > (size_t)sb.st_size)
                 {
                     if (mmapDebug)
@@ -1179,98 +5815,425 @@ int mmapConfigure(
                         name, addrspace, strerror(errno));
             }
 
-            if (size)
+            if (size && !(flags & FILE_DEVICE))
             {
                 /* map shared with other processes read/write or readonly */
+                flags |= SHARED_DEVICE;
                 if (mmapDebug)
                     printf("mmapConfigure %s: mmap(NULL, %"Z"u, %s, MAP_SHARED, %d=%s, %ld)\n",
                         name, mapsize, (flags & READONLY_DEVICE) ? "PROT_READ" : "PROT_READ|PROT_WRITE",
                         fd, addrspace, mapstart);
 
-                localbaseaddress = mmap(NULL, mapsize,
-                    (flags & READONLY_DEVICE) ? PROT_READ : PROT_READ|PROT_WRITE,
-                    MAP_SHARED, fd, mapstart);
+                if (shareable)
+                    localbaseaddress = mmapSharedMap(name, fd, &sb, mapstart, mapsize,
+                        (flags & READONLY_DEVICE) ? PROT_READ : PROT_READ|PROT_WRITE, openflags);
+                else
+                    localbaseaddress = mmap(NULL, mapsize,
+                        (flags & READONLY_DEVICE) ? PROT_READ : PROT_READ|PROT_WRITE,
+                        MAP_SHARED, fd, mapstart);
                 if (localbaseaddress == MAP_FAILED)
                 {
-                    errlogSevPrintf(errlogFatal,
-                        "mmapConfigure %s: Cannot mmap %s: %s\n",
-                        name, addrspace, errno == ENODEV ? "Device does not support mapping." : strerror(errno));
-                    return errno;
+                    localbaseaddress = NULL;
+#ifdef HAVE_FILEIO
+                    if (errno == ENODEV)
+                    {
+                        if (mmapDebug)
+                            printf("mmapConfigure %s: %s does not support mapping. Using file I/O.\n",
+                                name, addrspace);
+                        flags |= FILE_DEVICE;
+                    }
+                    else
+#endif /* HAVE_FILEIO */
+                    {
+                        errlogSevPrintf(errlogFatal,
+                            "mmapConfigure %s: Cannot mmap %s: %s\n",
+                            name, addrspace, errno == ENODEV ? "Device does not support mapping." : strerror(errno));
+                        close(fd);
+                        return errno;
+                    }
+                }
+                else
+                {
+                    /* adjust localbaseaddress by the offset within the page */
+                    if (mmapDebug)
+                        printf("mmapConfigure %s: mmap returned %p, adjusting by %ld bytes.\n",
+                            name, localbaseaddress, baseaddress - mapstart);
+                    localbaseaddress += (baseaddress - mapstart);
                 }
-                /* adjust localbaseaddress by the offset within the page */
-                if (mmapDebug)
-                    printf("mmapConfigure %s: mmap returned %p, adjusting by %ld bytes.\n",
-                        name, localbaseaddress, baseaddress - mapstart);
-                localbaseaddress += (baseaddress - mapstart);
             }
+#ifdef HAVE_FILEIO
+            if (flags & FILE_DEVICE)
+                fileDescriptor = fd; /* keep for file I/O */
+            else
+#endif /* HAVE_FILEIO */
             /* we don't need the file descriptor any more */
             close(fd);
         }
-    #endif /* HAVE_MMAP */
+    #endif /* HAVE_MMAP */
+    }
+
+#ifdef HAVE_FILEIO
+    if ((flags & FILE_DEVICE) && (flags & MAP_DEVICE))
+    {
+        errlogSevPrintf(errlogFatal,
+            "mmapConfigure %s: File I/O is incompatible with mapping.\n", name);
+        if (fileDescriptor >= 0) close(fileDescriptor);
+        return -1;
+    }
+#endif /* HAVE_FILEIO */
+
+    if ((flags & MAP_DEVICE) && (flags & (MAP_DEVICE|SWAP_BYTE_PAIRS|SWAP_WORD_PAIRS|SWAP_DWORD_PAIRS)))
+    {
+        errlogSevPrintf(errlogFatal,
+            "mmapConfigure %s: Swapping is incompatible with mapping.\n", name);
+        return -1;
+    }
+
+    device = (regDevice*)calloc(sizeof(regDevice),1);
+    if (device == NULL)
+    {
+        errlogSevPrintf(errlogFatal,
+            "mmapConfigure %s: Out of memory.\n",
+            name);
+        return errno;
+    }
+    device->magic = MAGIC;
+    device->name = strdup(name);
+    device->devtype = strdup(devtype);
+    device->vmespace = vmespace;
+    device->baseaddress = baseaddress;
+    device->localbaseaddress = localbaseaddress;
+    device->intrsource =
+#ifndef vxWorks
+            intrsource &&
+#endif
+            intrsource[0] ? strdup(intrsource) : NULL;
+    device->intrvector = intrvector;
+    device->intrlevel = intrlevel;
+    device->intrhandler = intrhandler;
+    device->userdata = userdata;
+    device->flags = flags;
+    device->size = size;
+#ifdef HAVE_FILEIO
+    device->fd = fileDescriptor;
+    if (flags & FILE_DEVICE)
+    {
+        device->fileLock = epicsMutexMustCreate();
+#ifdef HAVE_URING
+        if (mmapStartUring(device, fileQueueSize ? fileQueueSize : URING_DEFAULT_ENTRIES) != 0 && mmapDebug)
+            printf("mmapConfigure %s: Using pread/pwrite.\n", name);
+#endif /* HAVE_URING */
+    }
+#endif /* HAVE_FILEIO */
+    switch (vmespace)
+    {
+        case -1:
+            device->addrspace = "sim";
+            break;
+        case atVMECSR:
+            device->addrspace = "CR/CSR";
+            break;
+        case atVMEA16:
+            device->addrspace = "A16";
+            break;
+        case atVMEA24:
+            device->addrspace = "A24";
+            break;
+        case atVMEA32:
+            device->addrspace = "A32";
+            break;
+        default:
+#ifndef vxWorks
+            device->addrspace = strdup(addrspace);
+#else /* !vxWorks */
+            errlogSevPrintf(errlogFatal,
+                "mmapConfigure %s: Invalid addrspace %d.\n",
+                name, addrspace);
+#endif /* !vxWorks */
+    }
+    if (mmapDebug)
+        printf("mmapConfigure %s: vmespace = %d addrspace = %s\n",
+            name, vmespace, device->addrspace);
+
+#ifdef HAVE_WRITEBEHIND
+    if (writeBehindSize)
+    {
+        if (flags & (BLOCK_DEVICE|ALLOW_DMA|FILE_DEVICE))
+        {
+            errlogSevPrintf(errlogFatal,
+                "mmapConfigure %s: Write-behind is incompatible with block mode, dma and file I/O.\n", name);
+            return -1;
+        }
+        if (mmapStartWriteBehind(device, writeBehindSize) != 0)
+            return -1;
+    }
+#endif /* HAVE_WRITEBEHIND */
+
+    if (intrcauses && !intrstatus)
+    {
+        errlogSevPrintf(errlogFatal,
+            "mmapConfigure %s: Option intrcauses needs intrstatus.\n", name);
+        return -1;
+    }
+
+    if (intrstatus)
+    {
+        if (!localbaseaddress)
+        {
+            errlogSevPrintf(errlogFatal,
+                "mmapConfigure %s: Interrupt status decoding needs a mapped device.\n", name);
+            return -1;
+        }
+#ifdef HAVE_SNAPSHOT
+        if (snapshot)
+        {
+            /* cause scan lists would not read the snapshot of their interrupt */
+            errlogSevPrintf(errlogFatal,
+                "mmapConfigure %s: Options intrstatus and snapshot are incompatible.\n", name);
+            return -1;
+        }
+#endif /* HAVE_SNAPSHOT */
+        if (mmapConfigureIntrStatus(device, intrstatus, intrcauses) != 0)
+            return -1;
+    }
+
+    if (intrack)
+    {
+        if (!localbaseaddress)
+        {
+            errlogSevPrintf(errlogFatal,
+                "mmapConfigure %s: Interrupt acknowledge needs a mapped device.\n", name);
+            return -1;
+        }
+        if (mmapConfigureIntrAck(device, intrack) != 0)
+            return -1;
+    }
+
+    if (shards)
+    {
+        char* end;
+        unsigned long n = strtoul(shards, &end, 0);
+        if (*end == ':')
+        {
+            device->shardSize = strtoul(end+1, &end, 0);
+            if (device->shardSize == 0)
+                n = 0;
+        }
+        if (*end || n < 2 || n > MAX_INTR_SHARDS)
+        {
+            errlogSevPrintf(errlogFatal,
+                "mmapConfigure %s: Invalid shards=%s. Use shards=n[:size] with 2 <= n <= %d.\n",
+                name, shards, MAX_INTR_SHARDS);
+            return -1;
+        }
+#ifdef HAVE_SNAPSHOT
+        if (snapshot)
+        {
+            errlogSevPrintf(errlogFatal,
+                "mmapConfigure %s: Options shards and snapshot are incompatible.\n", name);
+            return -1;
+        }
+#endif /* HAVE_SNAPSHOT */
+        device->shards = n;
+    }
+
+#ifdef HAVE_SNAPSHOT
+    if (snapshot)
+    {
+        if (!localbaseaddress || (flags & BLOCK_DEVICE))
+        {
+            errlogSevPrintf(errlogFatal,
+                "mmapConfigure %s: Snapshot needs a mapped device and is incompatible with block mode.\n", name);
+            return -1;
+        }
+        if (mmapStartSnapshot(device, snapshot) != 0)
+            return -1;
+    }
+#endif /* HAVE_SNAPSHOT */
+
+#ifdef HAVE_SHADOW
+    if (shadow)
+    {
+        if (!localbaseaddress || (flags & BLOCK_DEVICE))
+        {
+            errlogSevPrintf(errlogFatal,
+                "mmapConfigure %s: Shadow registers need a mapped device and are incompatible with block mode.\n", name);
+            return -1;
+        }
+        if (mmapStartShadow(device, shadow) != 0)
+            return -1;
+    }
+#endif /* HAVE_SHADOW */
+
+#ifdef HAVE_MIRROR
+    if (mirror)
+    {
+        if (!localbaseaddress || (flags & BLOCK_DEVICE))
+        {
+            errlogSevPrintf(errlogFatal,
+                "mmapConfigure %s: Mirror needs a mapped device and is incompatible with block mode.\n", name);
+            return -1;
+        }
+        if (mmapStartMirror(device, mirror) != 0)
+            return -1;
+    }
+#endif /* HAVE_MIRROR */
+
+#ifdef HAVE_EXPORT
+    if (export)
+    {
+        if (!localbaseaddress)
+        {
+            errlogSevPrintf(errlogFatal,
+                "mmapConfigure %s: Export needs a mapped device.\n", name);
+            return -1;
+        }
+        if (mmapStartExport(device, export) != 0)
+            return -1;
+    }
+#endif /* HAVE_EXPORT */
+
+#ifdef HAVE_PUBLISH
+    if (publish)
+    {
+        if (!localbaseaddress)
+        {
+            errlogSevPrintf(errlogFatal,
+                "mmapConfigure %s: Publish needs a mapped device.\n", name);
+            return -1;
+        }
+        if (mmapStartPublish(device, publish) != 0)
+            return -1;
+    }
+#endif /* HAVE_PUBLISH */
+
+#ifdef HAVE_PARALLEL
+    if (parallel)
+    {
+        if (!localbaseaddress || (flags & BLOCK_DEVICE))
+        {
+            errlogSevPrintf(errlogFatal,
+                "mmapConfigure %s: Parallel copies need a mapped device and are incompatible with block mode.\n", name);
+            return -1;
+        }
+        if (mmapStartParallel(device, parallelSpec) != 0)
+            return -1;
+    }
+#endif /* HAVE_PARALLEL */
+
+#ifdef HAVE_CHUNK
+    if (chunk)
+    {
+        if (!localbaseaddress || (flags & BLOCK_DEVICE))
+        {
+            errlogSevPrintf(errlogFatal,
+                "mmapConfigure %s: Chunked transfers need a mapped device and are incompatible with block mode.\n", name);
+            return -1;
+        }
+#ifdef HAVE_PARALLEL
+        if (parallel)
+        {
+            errlogSevPrintf(errlogFatal,
+                "mmapConfigure %s: Options chunk and parallel are incompatible.\n", name);
+            return -1;
+        }
+#endif /* HAVE_PARALLEL */
+        if (mmapStartChunks(device, chunkSpec) != 0)
+            return -1;
+    }
+#endif /* HAVE_CHUNK */
+
+#ifdef HAVE_CAPTURE
+    if (capture)
+    {
+        if (!localbaseaddress || (flags & BLOCK_DEVICE))
+        {
+            errlogSevPrintf(errlogFatal,
+                "mmapConfigure %s: Capture needs a mapped device and is incompatible with block mode.\n", name);
+            return -1;
+        }
+        if (mmapStartCapture(device, capture) != 0)
+            return -1;
+    }
+    if (replay)
+    {
+        if (vmespace != -1)
+        {
+            errlogSevPrintf(errlogFatal,
+                "mmapConfigure %s: Option replay is only supported for sim.\n", name);
+            return -1;
+        }
+        if (mmapStartReplay(device, replay) != 0)
+            return -1;
+        if (device->intrvector < 0)
+        {
+            /* interrupts come from the replay */
+            device->intrvector = 0;
+            device->intrlevel = INTR_REPLAY;
+            device->intrsource = "replay";
+        }
     }
+#endif /* HAVE_CAPTURE */
 
-    if ((flags & MAP_DEVICE) && (flags & (MAP_DEVICE|SWAP_BYTE_PAIRS|SWAP_WORD_PAIRS|SWAP_DWORD_PAIRS)))
+#ifdef HAVE_MEMFD
+    device->memfd = memfdDescriptor;
+    if (memfdSeal && !memfd)
     {
         errlogSevPrintf(errlogFatal,
-            "mmapConfigure %s: Swapping is incompatible with mapping.\n", name);
+            "mmapConfigure %s: Option seal needs memfd.\n", name);
         return -1;
     }
-
-    device = (regDevice*)calloc(sizeof(regDevice),1);
-    if (device == NULL)
+    if (memfd)
     {
-        errlogSevPrintf(errlogFatal,
-            "mmapConfigure %s: Out of memory.\n",
-            name);
-        return errno;
+        if (vmespace != -1)
+        {
+            errlogSevPrintf(errlogFatal,
+                "mmapConfigure %s: Option memfd is only supported for sim.\n", name);
+            return -1;
+        }
+        if (memfdSocket && mmapStartMemfdServer(device, memfdSocket) != 0)
+            return -1;
     }
-    device->magic = MAGIC;
-    device->name = strdup(name);
-    device->devtype = strdup(devtype);
-    device->vmespace = vmespace;
-    device->baseaddress = baseaddress;
-    device->localbaseaddress = localbaseaddress;
-    device->intrsource =
-#ifndef vxWorks
-            intrsource &&
-#endif
-            intrsource[0] ? strdup(intrsource) : NULL;
-    device->intrvector = intrvector;
-    device->intrlevel = intrlevel;
-    device->intrhandler = intrhandler;
-    device->userdata = userdata;
-    device->flags = flags;
-    switch (vmespace)
+#endif /* HAVE_MEMFD */
+
+#ifdef HAVE_PERSIST
+    if (persist)
     {
-        case -1:
-            device->addrspace = "sim";
-            break;
-        case atVMECSR:
-            device->addrspace = "CR/CSR";
-            break;
-        case atVMEA16:
-            device->addrspace = "A16";
-            break;
-        case atVMEA24:
-            device->addrspace = "A24";
-            break;
-        case atVMEA32:
-            device->addrspace = "A32";
-            break;
-        default:
-#ifndef vxWorks
-            device->addrspace = strdup(addrspace);
-#else /* !vxWorks */
+        if (vmespace != -1)
+        {
             errlogSevPrintf(errlogFatal,
-                "mmapConfigure %s: Invalid addrspace %d.\n",
-                name, addrspace);
-#endif /* !vxWorks */
+                "mmapConfigure %s: Option persist is only supported for sim.\n", name);
+            return -1;
+        }
+        device->persist = strdup(persist);
+        mmapStartPersist(device, persistPeriod);
     }
-    if (mmapDebug)
-        printf("mmapConfigure %s: vmespace = %d addrspace = %s\n",
-            name, vmespace, device->addrspace);
+#endif /* HAVE_PERSIST */
+
+    /* work done at each interrupt must not wait for the first I/O Intr record */
+#ifdef HAVE_CAPTURE
+    if (capture && mmapConnectDeviceInterrupt(device, "Capture") != 0)
+        return -1;
+#endif /* HAVE_CAPTURE */
+#ifdef HAVE_MIRROR
+    if (mirror && device->mirror->period == 0 &&
+        mmapConnectDeviceInterrupt(device, "Mirror refresh at interrupts") != 0)
+        return -1;
+#endif /* HAVE_MIRROR */
+#ifdef HAVE_EXPORT
+    if (export && device->intrvector >= 0 && !(flags & BLOCK_DEVICE) && !device->mirror &&
+        mmapConnectDeviceInterrupt(device, "Export") != 0)
+        return -1;
+#endif /* HAVE_EXPORT */
+#ifdef HAVE_PUBLISH
+    if (publish && device->intrvector >= 0 &&
+        mmapConnectDeviceInterrupt(device, "Publish") != 0)
+        return -1;
+#endif /* HAVE_PUBLISH */
 
     regDevRegisterDevice(name, &mmapSupport, device, size);
+    device->next = mmapDevices;
+    mmapDevices = device;
 #ifdef HAVE_dmaAlloc
     if (vmespace > 0)
         regDevRegisterDmaAlloc(device, mmapDmaAlloc);
@@ -1306,8 +6269,489 @@ int mmapConfigure(
     return 0;
 }
 
+#ifndef vxWorks
+/* Configure many devices from a table file.
+   Each line has the same arguments as mmapConfigure, separated by
+   spaces or tabs. Arguments containing spaces must be quoted.
+   Empty lines and everything after # are ignored.
+*/
+
+#define MAX_CONFIG_ARGS 8
+
+static int mmapSplitConfigLine(char* line, char* args[])
+{
+    int n = 0;
+    char* p = line;
+
+    while (n < MAX_CONFIG_ARGS)
+    {
+        while (*p == ' ' || *p == '\t' || *p == '\n' || *p == '\r') p++;
+        if (!*p || *p == '#') break;
+        if (*p == '"')
+        {
+            args[n++] = ++p;
+            p = strchr(p, '"');
+            if (!p) return -1;
+        }
+        else
+        {
+            args[n++] = p;
+            p += strcspn(p, " \t\n\r#");
+            if (*p == '#') { *p = 0; break; }
+        }
+        if (!*p) break;
+        *p++ = 0;
+    }
+    return n;
+}
+
+int mmapConfigureFile(const char* filename)
+{
+    FILE* file;
+    char line[1024];
+    int lineno = 0;
+    int configured = 0;
+    int failed = 0;
+    epicsTimeStamp start, end;
+
+    if (!filename || !filename[0])
+    {
+        printf("usage: mmapConfigureFile(\"filename\")\n");
+        printf("configures one device per line of filename with the arguments of mmapConfigure:\n");
+        printf("  name baseaddress size addrspace intrsource intrlevel intrhandler userdata\n");
+        return 0;
+    }
+    file = fopen(filename, "r");
+    if (!file)
+    {
+        errlogSevPrintf(errlogFatal,
+            "mmapConfigureFile: Cannot open %s: %s\n",
+            filename, strerror(errno));
+        return -1;
+    }
+    epicsTimeGetCurrent(&start);
+
+    /* read system tables once for all devices */
+#ifdef __linux__
+    mmapReadProcDevices();
+#endif /* __linux__ */
+#ifdef HAVE_UIO
+    mmapReadUioDevices();
+#endif /* HAVE_UIO */
+
+    while (fgets(line, sizeof(line), file))
+    {
+        char* args[MAX_CONFIG_ARGS] = {NULL};
+        int n;
+
+        lineno++;
+        if (!strchr(line, '\n') && !feof(file))
+        {
+            int c;
+            errlogSevPrintf(errlogFatal,
+                "mmapConfigureFile %s line %d: Line too long (max %d characters).\n",
+                filename, lineno, (int)sizeof(line) - 2);
+            while ((c = getc(file)) != EOF && c != '\n');
+            failed++;
+            continue;
+        }
+        n = mmapSplitConfigLine(line, args);
+        if (n == 0) continue;
+        if (n < 3)
+        {
+            errlogSevPrintf(errlogFatal,
+                "mmapConfigureFile %s line %d: Need at least name, baseaddress and size.\n",
+                filename, lineno);
+            failed++;
+            continue;
+        }
+        if (mmapConfigure(args[0],
+            strtoul(args[1], NULL, 0),
+            strtoul(args[2], NULL, 0),
+            args[3], args[4],
+            args[5] ? strtol(args[5], NULL, 0) : 0,
+            args[6] && args[6][0] ? (int (*)(regDevice *))epicsFindSymbol(args[6]) : NULL,
+            args[7] ? strdup(args[7]) : NULL) != 0)
+        {
+            errlogSevPrintf(errlogFatal,
+                "mmapConfigureFile %s line %d: Configuring %s failed.\n",
+                filename, lineno, args[0]);
+            failed++;
+            continue;
+        }
+        configured++;
+    }
+    fclose(file);
+    epicsTimeGetCurrent(&end);
+    printf("mmapConfigureFile %s: %d devices configured, %d failed in %.3f seconds.\n",
+        filename, configured, failed, epicsTimeDiffInSeconds(&end, &start));
+    return failed;
+}
+#endif /* !vxWorks */
+
+/* Views: derived read-only devices with reduced copies of a large array
+   in another device, computed when read.
+*/
+
+#define VIEW_MIN     0
+#define VIEW_MAX     1
+#define VIEW_MINMAX  2
+#define VIEW_MEAN    3
+#define VIEW_STRIDE  4
+
+static const char* const mmapViewModes[] = { "min", "max", "minmax", "mean", "stride" };
+static const char* const mmapViewTypes[] = { "int8", "uint8", "int16", "uint16",
+    "int32", "uint32", "int64", "uint64", "float", "double" };
+static const unsigned char mmapViewTypeSize[] = { 1, 1, 2, 2, 4, 4, 8, 8, 4, 8 };
+
+typedef struct mmapView {
+    regDevice *parent;
+    size_t offset;                  /* of the array in the parent */
+    size_t bin;                     /* parent elements per bin */
+    size_t bins;
+    unsigned int type;
+    unsigned int dlen;
+    unsigned int mode;
+    unsigned int outputs;           /* elements per bin */
+    unsigned long long reads;
+} mmapView;
+
+#ifdef HAVE_AVX2
+/* Min and max of the first n rounded down to full vectors, returns number of elements done */
+#define VIEW_MINMAX_AVX2(NAME, T, VT, LANES, LOAD, STORE, MIN, MAX) \
+__attribute__((target("avx2"))) \
+static size_t NAME(const T* s, size_t n, T* pmin, T* pmax) \
+{ \
+    VT mn, mx; \
+    T t[LANES]; \
+    size_t i; \
+    unsigned int j; \
+    if (n < LANES) return 0; \
+    mn = mx = LOAD(s); \
+    for (i = LANES; i + LANES <= n; i += LANES) \
+    { \
+        VT v = LOAD(s + i); \
+        mn = MIN(mn, v); \
+        mx = MAX(mx, v); \
+    } \
+    STORE(t, mn); \
+    for (j = 0; j < LANES; j++) if (t[j] < *pmin) *pmin = t[j]; \
+    STORE(t, mx); \
+    for (j = 0; j < LANES; j++) if (t[j] > *pmax) *pmax = t[j]; \
+    return i; \
+}
+#define LOADI(p) _mm256_loadu_si256((const __m256i*)(p))
+#define STOREI(p, v) _mm256_storeu_si256((__m256i*)(p), v)
+VIEW_MINMAX_AVX2(mmapViewAvx2_int8, epicsInt8, __m256i, 32, LOADI, STOREI, _mm256_min_epi8, _mm256_max_epi8)
+VIEW_MINMAX_AVX2(mmapViewAvx2_uint8, epicsUInt8, __m256i, 32, LOADI, STOREI, _mm256_min_epu8, _mm256_max_epu8)
+VIEW_MINMAX_AVX2(mmapViewAvx2_int16, epicsInt16, __m256i, 16, LOADI, STOREI, _mm256_min_epi16, _mm256_max_epi16)
+VIEW_MINMAX_AVX2(mmapViewAvx2_uint16, epicsUInt16, __m256i, 16, LOADI, STOREI, _mm256_min_epu16, _mm256_max_epu16)
+VIEW_MINMAX_AVX2(mmapViewAvx2_int32, epicsInt32, __m256i, 8, LOADI, STOREI, _mm256_min_epi32, _mm256_max_epi32)
+VIEW_MINMAX_AVX2(mmapViewAvx2_uint32, epicsUInt32, __m256i, 8, LOADI, STOREI, _mm256_min_epu32, _mm256_max_epu32)
+VIEW_MINMAX_AVX2(mmapViewAvx2_float, epicsFloat32, __m256, 8, _mm256_loadu_ps, _mm256_storeu_ps, _mm256_min_ps, _mm256_max_ps)
+VIEW_MINMAX_AVX2(mmapViewAvx2_double, epicsFloat64, __m256d, 4, _mm256_loadu_pd, _mm256_storeu_pd, _mm256_min_pd, _mm256_max_pd)
+#undef LOADI
+#undef STOREI
+#define mmapViewAvx2_int64 NULL
+#define mmapViewAvx2_uint64 NULL
+#define VIEW_VECTOR(T) mmapViewAvx2_##T
+static int mmapViewHaveAvx2 = -1;
+#define VIEW_HAVE_VECTOR (mmapViewHaveAvx2 > 0)
+#else
+#define VIEW_VECTOR(T) NULL
+#define VIEW_HAVE_VECTOR 0
+#endif /* HAVE_AVX2 */
+
+/* Reduce bins first to first+nbins into out */
+#define VIEW_REDUCE(T, ET) \
+static void mmapViewReduce_##T(const mmapView* view, const char* base, size_t first, size_t nbins, char* out) \
+{ \
+    size_t (*vector)(const ET*, size_t, ET*, ET*) = VIEW_VECTOR(T); \
+    ET* o = (ET*)out; \
+    size_t b, i; \
+    for (b = first; b < first + nbins; b++) \
+    { \
+        const ET* s = (const ET*)base + b * view->bin; \
+        ET mn, mx; \
+        if (view->mode == VIEW_STRIDE) \
+        { \
+            *o++ = s[0]; \
+            continue; \
+        } \
+        if (view->mode == VIEW_MEAN) \
+        { \
+            double sum = 0; \
+            for (i = 0; i < view->bin; i++) sum += s[i]; \
+            *o++ = (ET)(sum / view->bin); \
+            continue; \
+        } \
+        mn = mx = s[0]; \
+        i = vector && VIEW_HAVE_VECTOR ? vector(s, view->bin, &mn, &mx) : 0; \
+        for (; i < view->bin; i++) \
+        { \
+            if (s[i] < mn) mn = s[i]; \
+            if (s[i] > mx) mx = s[i]; \
+        } \
+        if (view->mode != VIEW_MAX) *o++ = mn; \
+        if (view->mode != VIEW_MIN) *o++ = mx; \
+    } \
+}
+VIEW_REDUCE(int8, epicsInt8)
+VIEW_REDUCE(uint8, epicsUInt8)
+VIEW_REDUCE(int16, epicsInt16)
+VIEW_REDUCE(uint16, epicsUInt16)
+VIEW_REDUCE(int32, epicsInt32)
+VIEW_REDUCE(uint32, epicsUInt32)
+VIEW_REDUCE(int64, epicsInt64)
+VIEW_REDUCE(uint64, epicsUInt64)
+VIEW_REDUCE(float, epicsFloat32)
+VIEW_REDUCE(double, epicsFloat64)
+
+static void (*const mmapViewReduce[])(const mmapView*, const char*, size_t, size_t, char*) = {
+    mmapViewReduce_int8, mmapViewReduce_uint8, mmapViewReduce_int16, mmapViewReduce_uint16,
+    mmapViewReduce_int32, mmapViewReduce_uint32, mmapViewReduce_int64, mmapViewReduce_uint64,
+    mmapViewReduce_float, mmapViewReduce_double };
+
+static void mmapViewReport(
+    regDevice *device,
+    int level)
+{
+    mmapView* view;
+
+    if (!device || device->magic != MAGIC || !device->view)
+        return;
+    view = device->view;
+    printf("mmap view of %s:0x%"Z"x %s[%"Z"u] %s of %"Z"u\n",
+        view->parent->name, view->offset, mmapViewTypes[view->type],
+        view->bins * view->bin, mmapViewModes[view->mode], view->bin);
+    if (level > 0)
+        printf("    reads: %llu\n", view->reads);
+}
+
+static IOSCANPVT mmapViewGetInScanPvt(
+    regDevice *device,
+    size_t offset __attribute__((unused)),
+    unsigned int dlen,
+    size_t nelm,
+    int intrvector,
+    const char* user)
+{
+    /* views are scanned by the interrupts of the parent */
+    return mmapGetInScanPvt(device->view->parent, device->view->offset, dlen, nelm, intrvector, user);
+}
+
+static IOSCANPVT mmapViewGetOutScanPvt(
+    regDevice *device,
+    size_t offset __attribute__((unused)),
+    unsigned int dlen __attribute__((unused)),
+    size_t nelm __attribute__((unused)),
+    int intrvector __attribute__((unused)),
+    const char* user)
+{
+    errlogSevPrintf(errlogMajor,
+        "mmapViewGetOutScanPvt %s %s: Views are read-only.\n", user, device->name);
+    return NULL;
+}
+
+static int mmapViewRead(
+    regDevice *device,
+    size_t offset,
+    unsigned int dlen,
+    size_t nelem,
+    void* pdata,
+    int prio __attribute__((unused)),
+    regDevTransferComplete callback __attribute__((unused)),
+    const char* user)
+{
+    mmapView* view = device->view;
+    regDevice *parent = view->parent;
+    size_t first, last;
+    char* buffer;
+
+    if (dlen != view->dlen || offset % dlen)
+    {
+        errlogSevPrintf(errlogMajor,
+            "mmapViewRead %s %s: View elements are %s, cannot read %u bytes at 0x%"Z"x.\n",
+            user, device->name, mmapViewTypes[view->type], dlen, offset);
+        return -1;
+    }
+#ifdef HAVE_WRITEBEHIND
+    /* reduce what has been written */
+    if (parent->writeQueue && !mmapWriteQueueDone(parent->writeQueue))
+        mmapFlushDevice(parent);
+#endif /* HAVE_WRITEBEHIND */
+    first = offset / dlen / view->outputs;
+    last = (offset / dlen + nelem + view->outputs - 1) / view->outputs;
+    CACHE_INVALIDATE(parent, view->offset + first * view->bin * dlen, (last - first) * view->bin * dlen);
+    if ((offset / dlen) % view->outputs == 0 && nelem % view->outputs == 0)
+        mmapViewReduce[view->type](view, (const char*)parent->localbaseaddress + view->offset,
+            first, last - first, pdata);
+    else
+    {
+        /* request does not start or end at a bin boundary */
+        buffer = malloc((last - first) * view->outputs * dlen);
+        if (!buffer)
+        {
+            errlogSevPrintf(errlogMajor,
+                "mmapViewRead %s %s: Out of memory.\n", user, device->name);
+            return -1;
+        }
+        mmapViewReduce[view->type](view, (const char*)parent->localbaseaddress + view->offset,
+            first, last - first, buffer);
+        memcpy(pdata, buffer + offset - first * view->outputs * dlen, nelem * dlen);
+        free(buffer);
+    }
+    view->reads++;
+    TRACE(TRACE_READ, device, offset, nelem * dlen, TRACE_VIEW);
+    return 0;
+}
+
+static int mmapViewWrite(
+    regDevice *device,
+    size_t offset __attribute__((unused)),
+    unsigned int dlen __attribute__((unused)),
+    size_t nelem __attribute__((unused)),
+    void* pdata __attribute__((unused)),
+    void* pmask __attribute__((unused)),
+    int prio __attribute__((unused)),
+    regDevTransferComplete callback __attribute__((unused)),
+    const char* user)
+{
+    errlogSevPrintf(errlogMajor,
+        "mmapViewWrite %s %s: Views are read-only.\n", user, device->name);
+    return -1;
+}
+
+static regDevSupport mmapViewSupport = {
+    mmapViewReport,
+    mmapViewGetInScanPvt,
+    mmapViewGetOutScanPvt,
+    mmapViewRead,
+    mmapViewWrite
+};
+
+int mmapConfigureView(
+    const char* name,
+    const char* parentname,
+    size_t offset,
+    size_t count,
+    const char* type,
+    const char* mode,
+    size_t bin)
+{
+    regDevice *parent;
+    regDevice *device;
+    mmapView* view;
+    unsigned int vtype, vmode, dlen;
+
+    if (!name || !parentname || !type || !mode)
+    {
+        printf("usage: mmapConfigureView(\"name\", \"parent\", offset, count, \"type\", \"mode\", bin)\n");
+        printf("type: int8, uint8, int16, uint16, int32, uint32, int64, uint64, float, double\n");
+        printf("mode: min, max, minmax, mean, stride\n");
+        return -1;
+    }
+    for (parent = mmapDevices; parent; parent = parent->next)
+        if (strcmp(parent->name, parentname) == 0) break;
+    if (!parent)
+    {
+        errlogSevPrintf(errlogFatal,
+            "mmapConfigureView %s: Device %s not found.\n", name, parentname);
+        return -1;
+    }
+    if (!parent->localbaseaddress || (parent->flags & (SWAP_BYTE_PAIRS|SWAP_WORD_PAIRS|SWAP_DWORD_PAIRS)))
+    {
+        errlogSevPrintf(errlogFatal,
+            "mmapConfigureView %s: Device %s must be mapped and in native byte order.\n", name, parentname);
+        return -1;
+    }
+    for (vtype = 0; vtype < sizeof(mmapViewTypes)/sizeof(mmapViewTypes[0]); vtype++)
+        if (strcasecmp(type, mmapViewTypes[vtype]) == 0) break;
+    if (vtype == sizeof(mmapViewTypes)/sizeof(mmapViewTypes[0]))
+    {
+        errlogSevPrintf(errlogFatal,
+            "mmapConfigureView %s: Unknown type %s.\n", name, type);
+        return -1;
+    }
+    dlen = mmapViewTypeSize[vtype];
+    for (vmode = 0; vmode < sizeof(mmapViewModes)/sizeof(mmapViewModes[0]); vmode++)
+        if (strcasecmp(mode, mmapViewModes[vmode]) == 0) break;
+    if (vmode == sizeof(mmapViewModes)/sizeof(mmapViewModes[0]))
+    {
+        errlogSevPrintf(errlogFatal,
+            "mmapConfigureView %s: Unknown mode %s.\n", name, mode);
+        return -1;
+    }
+    if (bin == 0 || count < bin || offset % dlen ||
+        offset + count * dlen > parent->size)
+    {
+        errlogSevPrintf(errlogFatal,
+            "mmapConfigureView %s: Invalid array 0x%"Z"x * %s at 0x%"Z"x in %s of size 0x%"Z"x or bin %"Z"u.\n",
+            name, count, type, offset, parentname, parent->size, bin);
+        return -1;
+    }
+    /* views reduce the device memory, not the copies that records read */
+#define VIEW_OVERLAPS(o, s) ((o) < offset + count * dlen && offset < (o) + (s))
+    if (0
+#ifdef HAVE_SNAPSHOT
+        || (parent->snapshot && VIEW_OVERLAPS(parent->snapshot->offset, parent->snapshot->size))
+#endif /* HAVE_SNAPSHOT */
+#ifdef HAVE_SHADOW
+        || (parent->shadow && VIEW_OVERLAPS(parent->shadow->offset, parent->shadow->size))
+#endif /* HAVE_SHADOW */
+#ifdef HAVE_MIRROR
+        || (parent->mirror && VIEW_OVERLAPS(parent->mirror->offset, parent->mirror->size))
+#endif /* HAVE_MIRROR */
+        )
+    {
+        errlogSevPrintf(errlogFatal,
+            "mmapConfigureView %s: Array overlaps the snapshot, shadow or mirror region of %s.\n",
+            name, parentname);
+        return -1;
+    }
+#undef VIEW_OVERLAPS
+    view = calloc(1, sizeof(mmapView));
+    device = calloc(1, sizeof(regDevice));
+    if (!view || !device)
+    {
+        errlogSevPrintf(errlogFatal,
+            "mmapConfigureView %s: Out of memory.\n", name);
+        free(view);
+        free(device);
+        return -1;
+    }
+    view->type = vtype;
+    view->dlen = dlen;
+    view->mode = vmode;
+    view->outputs = view->mode == VIEW_MINMAX ? 2 : 1;
+    view->parent = parent;
+    view->offset = offset;
+    view->bin = bin;
+    view->bins = count / bin;       /* an incomplete last bin is ignored */
+#ifdef HAVE_AVX2
+    if (mmapViewHaveAvx2 < 0)
+    {
+        __builtin_cpu_init();
+        mmapViewHaveAvx2 = __builtin_cpu_supports("avx2");
+    }
+#endif /* HAVE_AVX2 */
+
+    device->magic = MAGIC;
+    device->name = strdup(name);
+    device->intrvector = -1;
+    device->view = view;
+    device->size = view->bins * view->outputs * view->dlen;
+    regDevRegisterDevice(name, &mmapViewSupport, device, device->size);
+    if (mmapDebug)
+        printf("mmapConfigureView %s: %s of %"Z"u %s in %s:0x%"Z"x, %"Z"u elements\n",
+            name, mmapViewModes[view->mode], bin, mmapViewTypes[view->type],
+            parentname, offset, view->bins * view->outputs);
+    return 0;
+}
+
 #ifndef EPICS_3_13
 epicsExportAddress(int, mmapDebug);
+epicsExportAddress(int, mmapTrace);
 
 #include <iocsh.h>
 static const iocshArg mmapConfigureArg0 = { "name", iocshArgString };
@@ -1351,9 +6795,110 @@ static void mmapConfigureFunc (const iocshArgBuf *args)
         args[7].sval);
 }
 
+#ifndef vxWorks
+static const iocshArg mmapConfigureFileArg0 = { "filename", iocshArgString };
+static const iocshArg * const mmapConfigureFileArgs[] = {
+    &mmapConfigureFileArg0
+};
+
+static const iocshFuncDef mmapConfigureFileDef =
+    { "mmapConfigureFile", 1, mmapConfigureFileArgs };
+
+static void mmapConfigureFileFunc (const iocshArgBuf *args)
+{
+    mmapConfigureFile(args[0].sval);
+}
+#endif /* !vxWorks */
+
+static const iocshArg mmapFlushArg0 = { "name", iocshArgString };
+static const iocshArg * const mmapFlushArgs[] = {
+    &mmapFlushArg0
+};
+
+static const iocshFuncDef mmapFlushDef =
+    { "mmapFlush", 1, mmapFlushArgs };
+
+static void mmapFlushFunc (const iocshArgBuf *args)
+{
+    mmapFlush(args[0].sval);
+}
+
+static const iocshArg mmapConfigureViewArg0 = { "name", iocshArgString };
+static const iocshArg mmapConfigureViewArg1 = { "parent", iocshArgString };
+static const iocshArg mmapConfigureViewArg2 = { "offset", iocshArgInt };
+static const iocshArg mmapConfigureViewArg3 = { "count", iocshArgInt };
+static const iocshArg mmapConfigureViewArg4 = { "type (int8..uint64,float,double)", iocshArgString };
+static const iocshArg mmapConfigureViewArg5 = { "mode (min,max,minmax,mean,stride)", iocshArgString };
+static const iocshArg mmapConfigureViewArg6 = { "bin", iocshArgInt };
+static const iocshArg * const mmapConfigureViewArgs[] = {
+    &mmapConfigureViewArg0,
+    &mmapConfigureViewArg1,
+    &mmapConfigureViewArg2,
+    &mmapConfigureViewArg3,
+    &mmapConfigureViewArg4,
+    &mmapConfigureViewArg5,
+    &mmapConfigureViewArg6
+};
+
+static const iocshFuncDef mmapConfigureViewDef =
+    { "mmapConfigureView", 7, mmapConfigureViewArgs };
+
+static void mmapConfigureViewFunc (const iocshArgBuf *args)
+{
+    mmapConfigureView(args[0].sval, args[1].sval, args[2].ival, args[3].ival,
+        args[4].sval, args[5].sval, args[6].ival);
+}
+
+#ifdef HAVE_CAPTURE
+static const iocshArg mmapReplayArg0 = { "name", iocshArgString };
+static const iocshArg mmapReplayArg1 = { "speed (default: configured)", iocshArgDouble };
+static const iocshArg * const mmapReplayArgs[] = {
+    &mmapReplayArg0,
+    &mmapReplayArg1
+};
+
+static const iocshFuncDef mmapReplayDef =
+    { "mmapReplay", 2, mmapReplayArgs };
+
+static void mmapReplayFunc (const iocshArgBuf *args)
+{
+    mmapReplay(args[0].sval, args[1].dval);
+}
+#endif /* HAVE_CAPTURE */
+
+#ifdef HAVE_TRACE
+static const iocshArg mmapTraceDumpArg0 = { "device (*=all)", iocshArgString };
+static const iocshArg mmapTraceDumpArg1 = { "event (read,write,intr,wakeup,flush, *=all)", iocshArgString };
+static const iocshArg mmapTraceDumpArg2 = { "count (default 100)", iocshArgInt };
+static const iocshArg * const mmapTraceDumpArgs[] = {
+    &mmapTraceDumpArg0,
+    &mmapTraceDumpArg1,
+    &mmapTraceDumpArg2
+};
+
+static const iocshFuncDef mmapTraceDumpDef =
+    { "mmapTraceDump", 3, mmapTraceDumpArgs };
+
+static void mmapTraceDumpFunc (const iocshArgBuf *args)
+{
+    mmapTraceDump(args[0].sval, args[1].sval, args[2].ival);
+}
+#endif /* HAVE_TRACE */
+
 static void mmapRegistrar ()
 {
     iocshRegister(&mmapConfigureDef, mmapConfigureFunc);
+#ifndef vxWorks
+    iocshRegister(&mmapConfigureFileDef, mmapConfigureFileFunc);
+#endif /* !vxWorks */
+    iocshRegister(&mmapFlushDef, mmapFlushFunc);
+    iocshRegister(&mmapConfigureViewDef, mmapConfigureViewFunc);
+#ifdef HAVE_CAPTURE
+    iocshRegister(&mmapReplayDef, mmapReplayFunc);
+#endif /* HAVE_CAPTURE */
+#ifdef HAVE_TRACE
+    iocshRegister(&mmapTraceDumpDef, mmapTraceDumpFunc);
+#endif /* HAVE_TRACE */
 }
 
 epicsExportRegistrar(mmapRegistrar);
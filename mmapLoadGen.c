@@ -0,0 +1,136 @@
+/* Load generator for the mmap driver:
+   writes frames into a shared memory file at a given rate
+   and optionally signals an interrupt after each frame.
+*/
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include <time.h>
+#include <unistd.h>
+#include <signal.h>
+
+#include "mmapProducer.h"
+
+static volatile int stop = 0;
+
+static void onSignal(int sig)
+{
+    stop = 1;
+}
+
+static double elapsed(const struct timespec* start, const struct timespec* end)
+{
+    return (end->tv_sec - start->tv_sec) + (end->tv_nsec - start->tv_nsec) * 1e-9;
+}
+
+static void usage(const char* prog)
+{
+    fprintf(stderr,
+        "usage: %s [options] file\n"
+        "writes frames into shared memory file (e.g. /dev/shm/name)\n"
+        "or into a memfd sim device of an IOC (unix:socketpath)\n"
+        "  -s size     frame payload size in bytes (default 1024)\n"
+        "  -o offset   offset of first frame (default 0)\n"
+        "  -k frames   number of frame slots used round robin (default 1)\n"
+        "  -r rate     frames per second, 0 for as fast as possible (default 10)\n"
+        "  -n count    number of frames to write, 0 for unlimited (default 0)\n"
+        "  -i signal   interrupt after each frame: FIFO or UNIX socket path, or fd=N for an eventfd\n"
+        "  -q          quiet: report only at the end\n",
+        prog);
+}
+
+int main(int argc, char* argv[])
+{
+    size_t framesize = 1024;
+    size_t offset = 0;
+    unsigned long slots = 1;
+    double rate = 10;
+    unsigned long long count = 0;
+    const char* signalpath = NULL;
+    int quiet = 0;
+    mmapProducer* producer;
+    char* payload;
+    size_t slotsize;
+    struct timespec start, next, now, lastreport;
+    unsigned long long n = 0, lastn = 0, errors = 0;
+    int c;
+
+    while ((c = getopt(argc, argv, "s:o:k:r:n:i:qh")) != -1)
+    {
+        switch (c)
+        {
+            case 's': framesize = strtoul(optarg, NULL, 0); break;
+            case 'o': offset = strtoul(optarg, NULL, 0); break;
+            case 'k': slots = strtoul(optarg, NULL, 0); break;
+            case 'r': rate = strtod(optarg, NULL); break;
+            case 'n': count = strtoull(optarg, NULL, 0); break;
+            case 'i': signalpath = optarg; break;
+            case 'q': quiet = 1; break;
+            default: usage(argv[0]); return c == 'h' ? 0 : 1;
+        }
+    }
+    if (optind != argc-1 || slots == 0)
+    {
+        usage(argv[0]);
+        return 1;
+    }
+
+    slotsize = sizeof(mmapFrameHeader) + framesize;
+    if (strncmp(argv[optind], "unix:", 5) == 0)
+        producer = mmapProducerAttach(argv[optind]+5, offset + slots * slotsize, signalpath);
+    else
+        producer = mmapProducerOpen(argv[optind], offset + slots * slotsize, signalpath);
+    if (!producer)
+    {
+        fprintf(stderr, "%s: Cannot open %s: %s\n", argv[0], argv[optind], strerror(errno));
+        return 1;
+    }
+    payload = malloc(framesize ? framesize : 1);
+    if (!payload)
+    {
+        fprintf(stderr, "%s: Out of memory\n", argv[0]);
+        return 1;
+    }
+    signal(SIGINT, onSignal);
+    signal(SIGTERM, onSignal);
+
+    clock_gettime(CLOCK_MONOTONIC, &start);
+    next = lastreport = start;
+    while (!stop && (count == 0 || n < count))
+    {
+        memset(payload, (int)n, framesize);
+        if (mmapProducerWriteFrame(producer, offset + (n % slots) * slotsize, payload, framesize) != 0)
+            errors++;
+        n++;
+
+        clock_gettime(CLOCK_MONOTONIC, &now);
+        if (!quiet && elapsed(&lastreport, &now) >= 1.0)
+        {
+            printf("%llu frames, %.1f frames/s, %.1f MB/s, %llu errors\n",
+                n, (n - lastn) / elapsed(&lastreport, &now),
+                (n - lastn) * framesize / elapsed(&lastreport, &now) * 1e-6, errors);
+            fflush(stdout);
+            lastreport = now;
+            lastn = n;
+        }
+        if (rate > 0)
+        {
+            /* absolute timing to avoid drift */
+            long period = (long)(1e9 / rate);
+            next.tv_nsec += period % 1000000000;
+            next.tv_sec += period / 1000000000 + next.tv_nsec / 1000000000;
+            next.tv_nsec %= 1000000000;
+            while (clock_nanosleep(CLOCK_MONOTONIC, TIMER_ABSTIME, &next, NULL) == EINTR && !stop);
+        }
+    }
+    clock_gettime(CLOCK_MONOTONIC, &now);
+    printf("total %llu frames of %lu bytes in %.3f s: %.1f frames/s, %.1f MB/s, %llu signals, %llu errors\n",
+        n, (unsigned long)framesize, elapsed(&start, &now),
+        n / elapsed(&start, &now), n * framesize / elapsed(&start, &now) * 1e-6,
+        mmapProducerSignals(producer), errors);
+    mmapProducerClose(producer);
+    free(payload);
+    return 0;
+}
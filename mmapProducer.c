@@ -0,0 +1,349 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <fcntl.h>
+#include <errno.h>
+#include <time.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <sys/socket.h>
+#include <sys/un.h>
+
+#include "mmapProducer.h"
+
+#ifndef O_CLOEXEC
+#define O_CLOEXEC 0
+#endif /* O_CLOEXEC */
+
+#define SIGNAL_NONE     0
+#define SIGNAL_FIFO     1
+#define SIGNAL_SOCKET   2
+#define SIGNAL_EVENTFD  3
+
+struct mmapProducer {
+    char* base;
+    size_t size;
+    int signaltype;
+    int signalfd;
+    uint32_t count;
+    unsigned long long frames;
+    unsigned long long signals;
+};
+
+static int mmapProducerOpenSignal(mmapProducer* producer, const char* signal)
+{
+    struct stat sb;
+
+    if (strncmp(signal, "fd=", 3) == 0)
+    {
+        producer->signalfd = atoi(signal+3);
+        producer->signaltype = SIGNAL_EVENTFD;
+        return 0;
+    }
+    if (stat(signal, &sb) != 0)
+        return -1;
+    if (S_ISSOCK(sb.st_mode))
+    {
+        struct sockaddr_un addr;
+
+        if (strlen(signal) >= sizeof(addr.sun_path))
+        {
+            errno = ENAMETOOLONG;
+            return -1;
+        }
+        memset(&addr, 0, sizeof(addr));
+        addr.sun_family = AF_UNIX;
+        strcpy(addr.sun_path, signal);
+        producer->signalfd = socket(AF_UNIX, SOCK_DGRAM | SOCK_CLOEXEC, 0);
+        if (producer->signalfd < 0)
+            return -1;
+        if (connect(producer->signalfd, (struct sockaddr*)&addr, sizeof(addr)) != 0)
+        {
+            close(producer->signalfd);
+            return -1;
+        }
+        producer->signaltype = SIGNAL_SOCKET;
+        return 0;
+    }
+    /* FIFO: non-blocking so that a slow reader cannot stop the producer */
+    producer->signalfd = open(signal, O_WRONLY | O_NONBLOCK | O_CLOEXEC);
+    if (producer->signalfd < 0)
+        return -1;
+    producer->signaltype = SIGNAL_FIFO;
+    return 0;
+}
+
+mmapProducer* mmapProducerOpen(const char* path, size_t size, const char* signal)
+{
+    mmapProducer* producer;
+    struct stat sb;
+    int fd;
+
+    producer = calloc(1, sizeof(mmapProducer));
+    if (!producer)
+        return NULL;
+    producer->signalfd = -1;
+
+    fd = open(path, O_RDWR | O_CREAT | O_CLOEXEC, 0666);
+    if (fd < 0)
+        goto fail;
+    if (fstat(fd, &sb) == 0 && S_ISREG(sb.st_mode) && (size_t)sb.st_size < size)
+    {
+        if (ftruncate(fd, size) != 0)
+        {
+            close(fd);
+            goto fail;
+        }
+    }
+    producer->base = mmap(NULL, size, PROT_READ|PROT_WRITE, MAP_SHARED, fd, 0);
+    close(fd);
+    if (producer->base == MAP_FAILED)
+        goto fail;
+    producer->size = size;
+
+    if (signal && signal[0] && mmapProducerOpenSignal(producer, signal) != 0)
+    {
+        munmap(producer->base, size);
+        goto fail;
+    }
+    return producer;
+fail:
+    free(producer);
+    return NULL;
+}
+
+mmapProducer* mmapProducerAttach(const char* socketpath, size_t size, const char* signal)
+{
+    mmapProducer* producer;
+    struct sockaddr_un addr;
+    uint64_t devsize;
+    struct iovec iov = { &devsize, sizeof(devsize) };
+    union {
+        struct cmsghdr hdr;
+        char buf[CMSG_SPACE(sizeof(int))];
+    } control;
+    struct msghdr msg;
+    struct cmsghdr *cmsg;
+    int sock, fd = -1;
+
+    if (strlen(socketpath) >= sizeof(addr.sun_path))
+    {
+        errno = ENAMETOOLONG;
+        return NULL;
+    }
+    producer = calloc(1, sizeof(mmapProducer));
+    if (!producer)
+        return NULL;
+    producer->signalfd = -1;
+
+    memset(&addr, 0, sizeof(addr));
+    addr.sun_family = AF_UNIX;
+    strcpy(addr.sun_path, socketpath);
+    sock = socket(AF_UNIX, SOCK_STREAM | SOCK_CLOEXEC, 0);
+    if (sock < 0)
+        goto fail;
+    if (connect(sock, (struct sockaddr*)&addr, sizeof(addr)) != 0)
+    {
+        close(sock);
+        goto fail;
+    }
+    memset(&msg, 0, sizeof(msg));
+    msg.msg_iov = &iov;
+    msg.msg_iovlen = 1;
+    msg.msg_control = control.buf;
+    msg.msg_controllen = sizeof(control.buf);
+    if (recvmsg(sock, &msg, MSG_CMSG_CLOEXEC) == sizeof(devsize) &&
+        (cmsg = CMSG_FIRSTHDR(&msg)) != NULL &&
+        cmsg->cmsg_level == SOL_SOCKET && cmsg->cmsg_type == SCM_RIGHTS)
+        memcpy(&fd, CMSG_DATA(cmsg), sizeof(int));
+    close(sock);
+    if (fd < 0)
+    {
+        errno = EPROTO;
+        goto fail;
+    }
+    if (size == 0)
+        size = devsize;
+    if (size > devsize)
+    {
+        close(fd);
+        errno = EINVAL;
+        goto fail;
+    }
+    producer->base = mmap(NULL, size, PROT_READ|PROT_WRITE, MAP_SHARED, fd, 0);
+    close(fd);
+    if (producer->base == MAP_FAILED)
+        goto fail;
+    producer->size = size;
+
+    if (signal && signal[0] && mmapProducerOpenSignal(producer, signal) != 0)
+    {
+        munmap(producer->base, size);
+        goto fail;
+    }
+    return producer;
+fail:
+    free(producer);
+    return NULL;
+}
+
+void* mmapProducerBase(mmapProducer* producer)
+{
+    return producer->base;
+}
+
+size_t mmapProducerSize(mmapProducer* producer)
+{
+    return producer->size;
+}
+
+int mmapProducerSignal(mmapProducer* producer)
+{
+    ssize_t n;
+
+    producer->count++;
+    switch (producer->signaltype)
+    {
+        case SIGNAL_FIFO:
+            n = write(producer->signalfd, &producer->count, sizeof(producer->count));
+            break;
+        case SIGNAL_SOCKET:
+            n = send(producer->signalfd, &producer->count, sizeof(producer->count), MSG_DONTWAIT);
+            break;
+        case SIGNAL_EVENTFD:
+        {
+            uint64_t one = 1;
+            n = write(producer->signalfd, &one, sizeof(one));
+            break;
+        }
+        default:
+            return 0;
+    }
+    if (n < 0)
+        return -1;
+    producer->signals++;
+    return 0;
+}
+
+int mmapProducerWriteFrame(mmapProducer* producer, size_t offset, const void* data, size_t len)
+{
+    mmapFrameHeader* header;
+    struct timespec now;
+
+    if (offset + sizeof(mmapFrameHeader) + len > producer->size)
+    {
+        errno = EINVAL;
+        return -1;
+    }
+    header = (mmapFrameHeader*)(producer->base + offset);
+    __atomic_store_n(&header->sequence, header->sequence | 1, __ATOMIC_RELAXED);
+    __atomic_thread_fence(__ATOMIC_RELEASE);
+    memcpy(header + 1, data, len);
+    header->size = len;
+    clock_gettime(CLOCK_REALTIME, &now);
+    header->timestamp = (uint64_t)now.tv_sec * 1000000000 + now.tv_nsec;
+    __atomic_store_n(&header->sequence, (header->sequence | 1) + 1, __ATOMIC_RELEASE);
+    producer->frames++;
+    return mmapProducerSignal(producer);
+}
+
+unsigned long long mmapProducerFrames(mmapProducer* producer)
+{
+    return producer->frames;
+}
+
+unsigned long long mmapProducerSignals(mmapProducer* producer)
+{
+    return producer->signals;
+}
+
+void mmapProducerClose(mmapProducer* producer)
+{
+    if (!producer)
+        return;
+    if (producer->signaltype == SIGNAL_FIFO || producer->signaltype == SIGNAL_SOCKET)
+        close(producer->signalfd);
+    munmap(producer->base, producer->size);
+    free(producer);
+}
+
+struct mmapConsumer {
+    mmapExportHeader* header;
+    size_t mapsize;
+};
+
+mmapConsumer* mmapConsumerOpen(const char* path)
+{
+    mmapConsumer* consumer;
+    struct stat sb;
+    int fd;
+
+    consumer = calloc(1, sizeof(mmapConsumer));
+    if (!consumer)
+        return NULL;
+    fd = open(path, O_RDONLY | O_CLOEXEC);
+    if (fd < 0)
+        goto fail;
+    if (fstat(fd, &sb) != 0 || (size_t)sb.st_size < sizeof(mmapExportHeader))
+    {
+        close(fd);
+        errno = EPROTO;
+        goto fail;
+    }
+    consumer->mapsize = sb.st_size;
+    consumer->header = mmap(NULL, consumer->mapsize, PROT_READ, MAP_SHARED, fd, 0);
+    close(fd);
+    if (consumer->header == MAP_FAILED)
+        goto fail;
+    if (memcmp(consumer->header->magic, MMAP_EXPORT_MAGIC, sizeof(consumer->header->magic)) != 0 ||
+        sizeof(mmapExportHeader) + consumer->header->size > consumer->mapsize)
+    {
+        munmap(consumer->header, consumer->mapsize);
+        errno = EPROTO;
+        goto fail;
+    }
+    return consumer;
+fail:
+    free(consumer);
+    return NULL;
+}
+
+const mmapExportHeader* mmapConsumerHeader(mmapConsumer* consumer)
+{
+    return consumer->header;
+}
+
+uint64_t mmapConsumerRead(mmapConsumer* consumer, size_t offset, void* buffer, size_t len)
+{
+    const char* data = (const char*)(consumer->header + 1);
+    uint64_t generation;
+    int retries;
+
+    if (offset + len > consumer->header->size)
+    {
+        errno = EINVAL;
+        return 0;
+    }
+    for (retries = 0; retries < 100000; retries++)
+    {
+        generation = __atomic_load_n(&consumer->header->generation, __ATOMIC_ACQUIRE);
+        if (generation & 1)
+            continue;
+        memcpy(buffer, data + offset, len);
+        __atomic_thread_fence(__ATOMIC_ACQUIRE);
+        if (__atomic_load_n(&consumer->header->generation, __ATOMIC_RELAXED) == generation)
+            return generation;
+    }
+    /* the IOC may have stopped in the middle of an update */
+    errno = EBUSY;
+    return 0;
+}
+
+void mmapConsumerClose(mmapConsumer* consumer)
+{
+    if (!consumer)
+        return;
+    munmap(consumer->header, consumer->mapsize);
+    free(consumer);
+}
@@ -0,0 +1,103 @@
+#ifndef mmapProducer_h
+#define mmapProducer_h
+
+/* Producer library for external processes writing frames into a shared
+   memory file that an IOC reads with the mmap driver, e.g.
+     mmapConfigure name, 0, size, /dev/shm/file
+   and reading regions the IOC exports with the export=file option.
+
+   Each frame starts with a header followed by the payload.
+   The sequence number is odd while a frame is being written and even
+   when the frame is complete, so readers can detect torn frames.
+*/
+
+#include <stddef.h>
+#include <stdint.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+typedef struct mmapFrameHeader {
+    uint32_t sequence;      /* odd while writing */
+    uint32_t size;          /* payload size in bytes */
+    uint64_t timestamp;     /* CLOCK_REALTIME in ns when frame was completed */
+} mmapFrameHeader;
+
+typedef struct mmapProducer mmapProducer;
+
+/* Map (and create or grow) file with size bytes.
+   signal (optional) is where to send an interrupt after each frame:
+     path of a FIFO         (writes a 4 byte count like uio)
+     path of a UNIX socket  (sends a 4 byte count datagram)
+     fd=N                   (writes an 8 byte 1 to an inherited eventfd)
+   Returns NULL on error with errno set.
+*/
+mmapProducer* mmapProducerOpen(const char* path, size_t size, const char* signal);
+
+/* Map the memory of a sim device configured with the memfd=socketpath
+   option. The IOC sends its memfd over the UNIX socket socketpath.
+   size 0 maps the whole device. signal is the same as for mmapProducerOpen.
+   Returns NULL on error with errno set (EINVAL if the device is too small).
+*/
+mmapProducer* mmapProducerAttach(const char* socketpath, size_t size, const char* signal);
+
+/* Start of the mapped memory */
+void* mmapProducerBase(mmapProducer* producer);
+
+/* Size of the mapped memory */
+size_t mmapProducerSize(mmapProducer* producer);
+
+/* Write a frame of len bytes at offset (header + payload) and signal.
+   Returns 0 on success, -1 on error with errno set.
+*/
+int mmapProducerWriteFrame(mmapProducer* producer, size_t offset, const void* data, size_t len);
+
+/* Send one interrupt. Returns 0 on success, -1 on error with errno set. */
+int mmapProducerSignal(mmapProducer* producer);
+
+/* Number of frames written and signals sent */
+unsigned long long mmapProducerFrames(mmapProducer* producer);
+unsigned long long mmapProducerSignals(mmapProducer* producer);
+
+void mmapProducerClose(mmapProducer* producer);
+
+/* Consumer of a region that an IOC exports with the export=file option.
+   The file starts with a header followed by size bytes of data.
+   The generation counter is odd while the IOC updates the data.
+*/
+#define MMAP_EXPORT_MAGIC "mmapexp1"
+
+typedef struct mmapExportHeader {
+    char magic[8];          /* MMAP_EXPORT_MAGIC */
+    uint64_t generation;    /* odd while updating */
+    uint64_t offset;        /* of the region in the device */
+    uint64_t size;          /* data bytes following the header */
+    uint64_t timestamp;     /* CLOCK_REALTIME in ns of the last update */
+    char device[24];        /* name of the device in the IOC */
+} mmapExportHeader;
+
+typedef struct mmapConsumer mmapConsumer;
+
+/* Map an export file read-only.
+   Returns NULL on error with errno set (EPROTO if it is not an export file).
+*/
+mmapConsumer* mmapConsumerOpen(const char* path);
+
+/* Header of the export, e.g. for size and device name */
+const mmapExportHeader* mmapConsumerHeader(mmapConsumer* consumer);
+
+/* Copy len bytes at offset (relative to the region) consistently,
+   retrying while the IOC updates the data.
+   Returns the generation of the copied data or 0 on error with errno set
+   (EBUSY if the data does not become consistent).
+*/
+uint64_t mmapConsumerRead(mmapConsumer* consumer, size_t offset, void* buffer, size_t len);
+
+void mmapConsumerClose(mmapConsumer* consumer);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* mmapProducer_h */
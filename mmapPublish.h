@@ -0,0 +1,57 @@
+#ifndef mmapPublish_h
+#define mmapPublish_h
+
+/* Publication of device regions to other IOC modules (e.g. a pvAccess
+   server) without copying the data into record fields.
+
+   A device configured with the publish=offset:size[:n] option copies the
+   region into one of n reference counted buffers at each interrupt
+   (or when mmapPublishTrigger is called) and passes the buffer to all
+   subscribers. A subscriber that needs the data beyond the callback calls
+   mmapBufferRetain and later mmapBufferRelease, e.g. in the deleter of a
+   pvxs::shared_array that references mmapBufferData. The data of a buffer
+   does not change while it is referenced.
+*/
+
+#include <stddef.h>
+#include <epicsTypes.h>
+#include <epicsTime.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+typedef struct mmapBuffer mmapBuffer;
+
+/* Called in the interrupt thread. Must not block. */
+typedef void (*mmapPublishCallback)(void* usr, mmapBuffer* buffer);
+
+/* Subscribe to the buffers of the device with the given name.
+   Returns 0 on success or -1 if the device has no publish option or
+   has too many subscribers.
+*/
+int mmapPublishSubscribe(const char* name, mmapPublishCallback callback, void* usr);
+
+/* Take a snapshot now, e.g. when a producer has flipped its buffers.
+   Returns 0 on success, 1 if all buffers are in use, -1 on error.
+*/
+int mmapPublishTrigger(const char* name);
+
+const void* mmapBufferData(const mmapBuffer* buffer);
+size_t mmapBufferSize(const mmapBuffer* buffer);
+
+/* Offset of the data in the device */
+size_t mmapBufferOffset(const mmapBuffer* buffer);
+
+/* Snapshot counter and time when the snapshot was taken */
+epicsUInt64 mmapBufferId(const mmapBuffer* buffer);
+const epicsTimeStamp* mmapBufferTime(const mmapBuffer* buffer);
+
+void mmapBufferRetain(mmapBuffer* buffer);
+void mmapBufferRelease(mmapBuffer* buffer);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* mmapPublish_h */
@@ -0,0 +1,210 @@
+/* Optional pvAccess server for regions published by mmap devices.
+   Built only if PVXS is defined in configure/RELEASE.
+
+   mmapPvaServe pvname, device, type[, ndarray]
+   serves the buffers of a device with the publish option as an
+   NTScalarArray (default) or NTNDArray. The array references the
+   buffer without copying it. The buffer is released when the last
+   client has sent it.
+*/
+
+#include <stdio.h>
+#include <string.h>
+#include <string>
+#include <list>
+#include <exception>
+
+#include <pvxs/server.h>
+#include <pvxs/sharedpv.h>
+#include <pvxs/nt.h>
+#include <pvxs/iochooks.h>
+
+#include <epicsTypes.h>
+#include <epicsTime.h>
+#include <errlog.h>
+#include <initHooks.h>
+#include <iocsh.h>
+
+#include "mmapPublish.h"
+
+#include <epicsExport.h>
+
+namespace {
+
+template<typename T>
+pvxs::shared_array<const void> mmapPvaWrap(mmapBuffer* buffer)
+{
+    mmapBufferRetain(buffer);
+    pvxs::shared_array<const T> data(static_cast<const T*>(mmapBufferData(buffer)),
+        [buffer](const T*) { mmapBufferRelease(buffer); },
+        mmapBufferSize(buffer) / sizeof(T));
+    return data.template castTo<const void>();
+}
+
+struct mmapPvaType {
+    const char* name;
+    pvxs::TypeCode code;
+    const char* member;     /* of the NTNDArray value union */
+    size_t size;
+    pvxs::shared_array<const void> (*wrap)(mmapBuffer*);
+};
+
+const mmapPvaType mmapPvaTypes[] = {
+    { "int8",   pvxs::TypeCode::Int8A,    "byteValue",   1, mmapPvaWrap<epicsInt8> },
+    { "uint8",  pvxs::TypeCode::UInt8A,   "ubyteValue",  1, mmapPvaWrap<epicsUInt8> },
+    { "int16",  pvxs::TypeCode::Int16A,   "shortValue",  2, mmapPvaWrap<epicsInt16> },
+    { "uint16", pvxs::TypeCode::UInt16A,  "ushortValue", 2, mmapPvaWrap<epicsUInt16> },
+    { "int32",  pvxs::TypeCode::Int32A,   "intValue",    4, mmapPvaWrap<epicsInt32> },
+    { "uint32", pvxs::TypeCode::UInt32A,  "uintValue",   4, mmapPvaWrap<epicsUInt32> },
+    { "int64",  pvxs::TypeCode::Int64A,   "longValue",   8, mmapPvaWrap<epicsInt64> },
+    { "uint64", pvxs::TypeCode::UInt64A,  "ulongValue",  8, mmapPvaWrap<epicsUInt64> },
+    { "float",  pvxs::TypeCode::Float32A, "floatValue",  4, mmapPvaWrap<epicsFloat32> },
+    { "double", pvxs::TypeCode::Float64A, "doubleValue", 8, mmapPvaWrap<epicsFloat64> },
+};
+
+struct mmapPva {
+    std::string name;
+    const mmapPvaType* type;
+    bool ndarray;
+    pvxs::Value prototype;
+    pvxs::server::SharedPV pv;
+    unsigned long long errors;
+};
+
+std::list<mmapPva> mmapPvas;
+bool mmapPvaRunning = false;
+
+void mmapPvaSetTime(pvxs::Value& val, const char* field, const epicsTimeStamp* ts)
+{
+    val[std::string(field) + ".secondsPastEpoch"] = int64_t(ts->secPastEpoch) + POSIX_TIME_AT_EPICS_EPOCH;
+    val[std::string(field) + ".nanoseconds"] = int32_t(ts->nsec);
+}
+
+/* Called in the interrupt thread of the device */
+void mmapPvaPost(void* usr, mmapBuffer* buffer)
+{
+    mmapPva* pva = static_cast<mmapPva*>(usr);
+    const epicsTimeStamp* ts = mmapBufferTime(buffer);
+
+    try
+    {
+        pvxs::Value val(pva->prototype.cloneEmpty());
+        if (pva->ndarray)
+        {
+            pvxs::shared_array<pvxs::Value> dims(1);
+            dims[0] = val["dimension"].allocMember();
+            dims[0]["size"] = int32_t(mmapBufferSize(buffer) / pva->type->size);
+            val["dimension"] = dims.freeze();
+            val[std::string("value->") + pva->type->member] = pva->type->wrap(buffer);
+            val["uniqueId"] = int32_t(mmapBufferId(buffer));
+            mmapPvaSetTime(val, "dataTimeStamp", ts);
+        }
+        else
+            val["value"] = pva->type->wrap(buffer);
+        mmapPvaSetTime(val, "timeStamp", ts);
+        pva->pv.post(val);
+    }
+    catch (std::exception& e)
+    {
+        if (pva->errors++ == 0)
+            errlogPrintf("mmapPvaPost %s: %s\n", pva->name.c_str(), e.what());
+    }
+}
+
+void mmapPvaInitHook(initHookState state)
+{
+    if (state != initHookAfterIocBuilt)
+        return;
+    for (auto& pva : mmapPvas)
+        pvxs::ioc::server().addPV(pva.name, pva.pv);
+    mmapPvaRunning = true;
+}
+
+} // namespace
+
+extern "C"
+int mmapPvaServe(const char* pvname, const char* device, const char* type, const char* nt)
+{
+    const mmapPvaType* t = NULL;
+    size_t i;
+
+    if (!pvname || !device || !type)
+    {
+        printf("usage: mmapPvaServe pvname, device, type[, ndarray]\n");
+        return -1;
+    }
+    for (i = 0; i < sizeof(mmapPvaTypes)/sizeof(mmapPvaTypes[0]); i++)
+        if (strcmp(type, mmapPvaTypes[i].name) == 0)
+            t = &mmapPvaTypes[i];
+    if (!t)
+    {
+        errlogSevPrintf(errlogFatal,
+            "mmapPvaServe %s: Invalid type %s. Use int8, uint8, int16, uint16, int32, uint32, int64, uint64, float or double.\n",
+            pvname, type);
+        return -1;
+    }
+    if (nt && *nt && strcmp(nt, "ndarray") != 0)
+    {
+        errlogSevPrintf(errlogFatal,
+            "mmapPvaServe %s: Invalid normative type %s. Use ndarray or nothing for NTScalarArray.\n",
+            pvname, nt);
+        return -1;
+    }
+    try
+    {
+        mmapPvas.emplace_back();
+        mmapPva& pva = mmapPvas.back();
+        pva.name = pvname;
+        pva.type = t;
+        pva.ndarray = nt && *nt;
+        pva.errors = 0;
+        pva.prototype = pva.ndarray ? pvxs::nt::NTNDArray{}.create() : pvxs::nt::NTScalar{t->code}.create();
+        pva.pv = pvxs::server::SharedPV::buildReadonly();
+        pva.pv.open(pva.prototype.cloneEmpty());
+        if (mmapPublishSubscribe(device, mmapPvaPost, &pva) != 0)
+        {
+            errlogSevPrintf(errlogFatal,
+                "mmapPvaServe %s: Device %s does not publish or has too many subscribers.\n",
+                pvname, device);
+            mmapPvas.pop_back();
+            return -1;
+        }
+        if (mmapPvaRunning)
+            pvxs::ioc::server().addPV(pva.name, pva.pv);
+    }
+    catch (std::exception& e)
+    {
+        errlogSevPrintf(errlogFatal, "mmapPvaServe %s: %s\n", pvname, e.what());
+        return -1;
+    }
+    return 0;
+}
+
+static const iocshArg mmapPvaServeArg0 = { "pvname", iocshArgString };
+static const iocshArg mmapPvaServeArg1 = { "device", iocshArgString };
+static const iocshArg mmapPvaServeArg2 = { "type", iocshArgString };
+static const iocshArg mmapPvaServeArg3 = { "ndarray", iocshArgString };
+static const iocshArg * const mmapPvaServeArgs[] = {
+    &mmapPvaServeArg0,
+    &mmapPvaServeArg1,
+    &mmapPvaServeArg2,
+    &mmapPvaServeArg3
+};
+
+static const iocshFuncDef mmapPvaServeDef =
+    { "mmapPvaServe", 4, mmapPvaServeArgs };
+
+static void mmapPvaServeFunc (const iocshArgBuf *args)
+{
+    mmapPvaServe(args[0].sval, args[1].sval, args[2].sval, args[3].sval);
+}
+
+static void mmapPvaRegistrar ()
+{
+    iocshRegister(&mmapPvaServeDef, mmapPvaServeFunc);
+    initHookRegister(mmapPvaInitHook);
+}
+
+extern "C" {
+epicsExportRegistrar(mmapPvaRegistrar);
+}